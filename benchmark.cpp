@@ -0,0 +1,775 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "command_line.h"
+#include "dense_floyd_warshall.h"
+#include "edge_list.h"
+#include "fixed_floyd_warshall.h"
+#include "floyd_warshall.h"
+#include "gpu_floyd_warshall.h"
+#include "graph_generator.h"
+#include "johnson.h"
+#include "out_of_core_floyd_warshall.h"
+
+// Times load, solve and write separately for every engine over a sweep of
+// synthetic graphs (or over given input files), with warm-up runs, and
+// reports median / p95 / min per phase as CSV or JSON. With --check it instead
+// verifies that every engine gives the reference distances on the input/
+// fixtures and a few generated graphs, and compares each engine's solve
+// throughput with a stored baseline.
+
+using Clock = std::chrono::steady_clock;
+
+const std::string SCRATCH_FILE = "benchmark-scratch.txt";
+
+struct BenchmarkOptions {
+    std::vector<std::string> engines = { "dense", "tiled", "johnson" };
+    std::vector<std::size_t> vertices = { 256, 512, 1024 };
+    std::vector<double> densities = { 0.01, 0.1, 0.5 };
+    std::vector<std::string> inputs;
+    std::size_t repeats = 5;
+    std::size_t warmup = 1;
+    std::size_t threads = 1;
+    uint64_t seed = 1;
+    WeightType weight = WeightType::Auto;
+    bool json = false;
+    std::string output;
+    bool check = false;
+    // Baseline throughputs to compare against and to write, for --check.
+    std::string baseline;
+    std::string save_baseline;
+    // Largest allowed drop below the baseline throughput, as a fraction.
+    double tolerance = 0.25;
+};
+
+// Defaults of --check: every CPU engine variant, and graphs small enough for
+// the fixed-size and map engines next to ones where the kernels differ in
+// speed. CheckEngines() adds gpu when a device is present.
+const std::vector<std::string> CHECK_ENGINES = { "map",     "fixed",   "scalar",     "dense",   "tiled",
+                                                 "threaded", "johnson", "components", "external" };
+const std::vector<std::size_t> CHECK_VERTICES = { 32, 128, 512 };
+const std::vector<double> CHECK_DENSITIES = { 0.02, 0.3 };
+// The map engine takes seconds from about this size on, so larger graphs are
+// checked against the first other engine instead.
+const std::size_t CHECK_MAP_MAX_VERTICES = 128;
+// Generated graphs of --check get negative edges, but no negative cycle.
+const int32_t CHECK_POTENTIAL_RANGE = 50;
+// Shorter solves are reported, but too noisy to compare with a baseline.
+const double CHECK_MIN_SOLVE_MS = 5;
+// Tile file of the external engine under --check.
+const std::string CHECK_TILE_FILE = "output/" + SCRATCH_FILE + ".tiles";
+
+std::vector<std::string> CheckEngines() {
+    std::vector<std::string> engines = CHECK_ENGINES;
+    if (GpuAvailable()) {
+        engines.push_back("gpu");
+    }
+    return engines;
+}
+
+struct PhaseTimes {
+    std::vector<double> load;
+    std::vector<double> solve;
+    std::vector<double> write;
+};
+
+struct Case {
+    std::string graph;
+    std::string input_path;
+    std::size_t vertices;
+    std::size_t edges;
+    WeightType weight;
+};
+
+Case MakeCase(std::string graph_name, std::string input_path, const EdgeList& graph, WeightType weight) {
+    return { std::move(graph_name), std::move(input_path), graph.vertices.size(), graph.Edges().size(),
+             weight == WeightType::Auto ? NarrowestWeightType(graph) : weight };
+}
+
+double Milliseconds(Clock::time_point start, Clock::time_point stop) {
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template<template<typename> class Engine, typename Weight>
+void TimeRun(const Case& bench_case, const DenseOptions& options, PhaseTimes& times) {
+    const auto start = Clock::now();
+    EdgeList graph = LoadEdgeList(bench_case.input_path, options.threads);
+    const auto loaded = Clock::now();
+    Engine<Weight> engine(std::move(graph), options);
+    engine.GenerateDistanceMatrix();
+    const auto solved = Clock::now();
+    engine.PrintDistances(SCRATCH_FILE);
+    const auto written = Clock::now();
+
+    times.load.push_back(Milliseconds(start, loaded));
+    times.solve.push_back(Milliseconds(loaded, solved));
+    times.write.push_back(Milliseconds(solved, written));
+}
+
+// The map engine reads its input in the constructor, which also builds the
+// distance map, so its load phase includes that initialisation.
+void TimeMapRun(const Case& bench_case, PhaseTimes& times) {
+    const auto start = Clock::now();
+    FloydWarshall engine(bench_case.input_path.substr(std::string("input/").size()));
+    const auto loaded = Clock::now();
+    engine.GenerateDistanceMatrix();
+    const auto solved = Clock::now();
+    engine.PrintDistances(SCRATCH_FILE);
+    const auto written = Clock::now();
+
+    times.load.push_back(Milliseconds(start, loaded));
+    times.solve.push_back(Milliseconds(loaded, solved));
+    times.write.push_back(Milliseconds(solved, written));
+}
+
+// Kernel settings of an engine name: "scalar" is the dense kernel without
+// SIMD, "threaded" the tiled kernel on --threads threads, or on every
+// hardware thread (at least two) when --threads is 1. "external" gets the
+// smallest tile, so that the graphs of --check span several tiles.
+DenseOptions EngineOptions(const std::string& engine, const BenchmarkOptions& options) {
+    DenseOptions dense;
+    dense.threads = options.threads;
+    if (engine == "tiled") {
+        dense.kernel = DenseKernel::Blocked;
+    }
+    else if (engine == "threaded") {
+        dense.kernel = DenseKernel::Blocked;
+        if (options.threads == 1) {
+            dense.threads = std::max<std::size_t>(2, std::thread::hardware_concurrency());
+        }
+    }
+    else if (engine == "scalar") {
+        dense.simd = SimdLevel::Scalar;
+    }
+    else if (engine == "gpu") {
+        dense.kernel = DenseKernel::Gpu;
+    }
+    else if (engine == "components") {
+        dense.kernel = DenseKernel::Components;
+    }
+    else if (engine == "external") {
+        dense.tile_size = 32;
+    }
+    return dense;
+}
+
+void TimeOnce(const std::string& engine, const Case& bench_case, const BenchmarkOptions& options, PhaseTimes& times) {
+    if (engine == "map") {
+        TimeMapRun(bench_case, times);
+        return;
+    }
+
+    const DenseOptions dense = EngineOptions(engine, options);
+    WithWeightType(bench_case.weight, [&](auto type) {
+        using Weight = typename decltype(type)::type;
+        if (engine == "johnson") {
+            TimeRun<Johnson, Weight>(bench_case, dense, times);
+        }
+        else {
+            TimeRun<DenseFloydWarshall, Weight>(bench_case, dense, times);
+        }
+    });
+}
+
+struct Summary {
+    double median;
+    double p95;
+    double min;
+};
+
+Summary Summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    const std::size_t n = samples.size();
+    const double median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    const std::size_t p95_rank = static_cast<std::size_t>(std::ceil(0.95 * static_cast<double>(n)));
+    return { median, samples[std::max<std::size_t>(p95_rank, 1) - 1], samples.front() };
+}
+
+const char* WeightName(WeightType weight) {
+    switch (weight) {
+    case WeightType::Int32:
+        return "int32";
+    case WeightType::Float:
+        return "float";
+    default:
+        return "double";
+    }
+}
+
+class Report {
+public:
+    Report(std::ostream& out, bool json)
+        : out_(out), json_(json) {
+        if (json_) {
+            out_ << "[";
+        }
+        else {
+            out_ << "engine,graph,vertices,edges,weight,phase,runs,median_ms,p95_ms,min_ms\n";
+        }
+    }
+
+    ~Report() {
+        if (json_) {
+            out_ << "\n]\n";
+        }
+        out_.flush();
+    }
+
+    void Add(const std::string& engine, const Case& bench_case, const char* phase, const std::vector<double>& samples) {
+        const Summary summary = Summarize(samples);
+        // The map engine always works in double.
+        const char* weight = engine == "map" ? "double" : WeightName(bench_case.weight);
+        if (json_) {
+            out_ << (rows_++ ? ",\n" : "\n") << "  {\"engine\": \"" << engine << "\", \"graph\": \"" << bench_case.graph
+                 << "\", \"vertices\": " << bench_case.vertices << ", \"edges\": " << bench_case.edges
+                 << ", \"weight\": \"" << weight << "\", \"phase\": \"" << phase
+                 << "\", \"runs\": " << samples.size() << ", \"median_ms\": " << summary.median
+                 << ", \"p95_ms\": " << summary.p95 << ", \"min_ms\": " << summary.min << "}";
+        }
+        else {
+            out_ << engine << ',' << bench_case.graph << ',' << bench_case.vertices << ',' << bench_case.edges << ','
+                 << weight << ',' << phase << ',' << samples.size() << ',' << summary.median
+                 << ',' << summary.p95 << ',' << summary.min << '\n';
+        }
+    }
+
+private:
+    std::ostream& out_;
+    bool json_;
+    std::size_t rows_ = 0;
+};
+
+void RunCase(const Case& bench_case, const BenchmarkOptions& options, Report& report) {
+    for (const auto& engine : options.engines) {
+        std::cerr << engine << " on " << bench_case.graph << " (V=" << bench_case.vertices
+                  << ", E=" << bench_case.edges << ")" << std::endl;
+        PhaseTimes discarded;
+        for (std::size_t run = 0; run < options.warmup; ++run) {
+            TimeOnce(engine, bench_case, options, discarded);
+        }
+        PhaseTimes times;
+        for (std::size_t run = 0; run < options.repeats; ++run) {
+            TimeOnce(engine, bench_case, options, times);
+        }
+        report.Add(engine, bench_case, "load", times.load);
+        report.Add(engine, bench_case, "solve", times.solve);
+        report.Add(engine, bench_case, "write", times.write);
+    }
+}
+
+// One engine's runs over a case for --check: the solve times after warm-up
+// and the distances of the last run in double, row-major by vertex id, with
+// infinities for unreachable and unbounded pairs.
+struct CheckedRun {
+    std::string engine;
+    std::vector<double> solve_ms;
+    std::vector<double> dist;
+    bool negative_cycle = false;
+};
+
+// `make_engine` builds the engine from the case's input for every run.
+template<typename Weight, typename MakeEngine>
+void CheckedSolve(const BenchmarkOptions& bench, CheckedRun& run, MakeEngine&& make_engine) {
+    using Traits = WeightTraits<Weight>;
+    for (std::size_t r = 0; r < bench.warmup + bench.repeats; ++r) {
+        auto engine = make_engine();
+        const auto start = Clock::now();
+        try {
+            engine.GenerateDistanceMatrix();
+        }
+        catch (const NegativeCycleException&) {
+            run.negative_cycle = true;
+            return;
+        }
+        if (r >= bench.warmup) {
+            run.solve_ms.push_back(Milliseconds(start, Clock::now()));
+        }
+        if (r + 1 == bench.warmup + bench.repeats) {
+            const auto to_double = [](Weight value) {
+                return value == Traits::Infinity() ? std::numeric_limits<double>::infinity()
+                     : value == Traits::NegativeInfinity() ? -std::numeric_limits<double>::infinity()
+                                                           : static_cast<double>(value);
+            };
+            const std::size_t n = engine.Vertices().size();
+            run.dist.resize(n * n);
+            // The external engine keeps its matrices in tiles, so it is read
+            // cell by cell.
+            if constexpr (requires { engine.Result(); }) {
+                const std::span<const Weight> dist = engine.Result().Distances();
+                std::transform(dist.begin(), dist.end(), run.dist.begin(), to_double);
+            }
+            else {
+                for (std::size_t cell = 0; cell < n * n; ++cell) {
+                    run.dist[cell] = to_double(engine.Distance(cell / n, cell % n));
+                }
+            }
+        }
+    }
+}
+
+// The map engine has no negative-cycle detection; its distances are only
+// meaningful when the other engines find no cycle.
+void CheckedMapSolve(const Case& bench_case, const VertexDictionary& vertices, const BenchmarkOptions& bench,
+                     CheckedRun& run) {
+    const std::size_t n = vertices.size();
+    for (std::size_t r = 0; r < bench.warmup + bench.repeats; ++r) {
+        FloydWarshall engine(bench_case.input_path.substr(std::string("input/").size()));
+        const auto start = Clock::now();
+        engine.GenerateDistanceMatrix();
+        if (r >= bench.warmup) {
+            run.solve_ms.push_back(Milliseconds(start, Clock::now()));
+        }
+        if (r + 1 == bench.warmup + bench.repeats) {
+            run.dist.resize(n * n);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (std::size_t j = 0; j < n; ++j) {
+                    const double value = engine.Distance(std::string(vertices.Name(i)), std::string(vertices.Name(j)));
+                    run.dist[i * n + j] = value == DOUBLE_MAX ? std::numeric_limits<double>::infinity() : value;
+                }
+            }
+        }
+    }
+}
+
+// Nominal relaxations of one solve, so that the throughput of an engine is
+// comparable across builds with and without FW_INSTRUMENTATION: V^3 cells
+// for the Floyd-Warshall engines, V * E scanned edges for Johnson.
+double NominalRelaxations(const std::string& engine, const Case& bench_case) {
+    const double vertices = static_cast<double>(bench_case.vertices);
+    return engine == "johnson" ? vertices * static_cast<double>(bench_case.edges) : vertices * vertices * vertices;
+}
+
+std::string BaselineKey(const std::string& engine, const Case& bench_case) {
+    return engine + ',' + bench_case.graph + ',' + std::to_string(bench_case.vertices);
+}
+
+// Baseline file: a header line, then "engine,graph,vertices,relaxations_per_s"
+// rows as written by --save-baseline.
+std::map<std::string, double> ReadBaseline(const std::string& file_name) {
+    std::ifstream file(file_name);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + file_name);
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        const std::size_t comma = line.rfind(',');
+        if (comma == std::string::npos) {
+            continue;
+        }
+        baseline[line.substr(0, comma)] = std::stod(line.substr(comma + 1));
+    }
+    return baseline;
+}
+
+bool SameDistance(double lhs, double rhs) {
+    if (std::isinf(lhs) || std::isinf(rhs)) {
+        return lhs == rhs;
+    }
+    // Johnson sums reweighted doubles, which can differ in the last bits.
+    return std::abs(lhs - rhs) <= 1e-9 * std::max(1.0, std::abs(lhs));
+}
+
+class CheckReport {
+public:
+    explicit CheckReport(std::ostream& out)
+        : out_(out) {
+        out_ << "engine,graph,vertices,edges,weight,result,median_solve_ms,relaxations_per_s,baseline_relaxations_per_s\n";
+    }
+
+    ~CheckReport() {
+        out_.flush();
+    }
+
+    void Add(const CheckedRun& run, const Case& bench_case, const std::string& result, double throughput,
+             double baseline) {
+        const char* weight = run.engine == "map" ? "double" : WeightName(bench_case.weight);
+        out_ << run.engine << ',' << bench_case.graph << ',' << bench_case.vertices << ',' << bench_case.edges << ','
+             << weight << ',' << result << ',';
+        if (!run.solve_ms.empty()) {
+            out_ << Summarize(run.solve_ms).median << ',' << throughput;
+        }
+        else {
+            out_ << ',';
+        }
+        out_ << ',';
+        if (baseline > 0) {
+            out_ << baseline;
+        }
+        out_ << '\n';
+    }
+
+private:
+    std::ostream& out_;
+};
+
+// Runs every engine on the case and checks it against the reference: the map
+// engine where it ran, otherwise the first engine of the list. When any
+// engine reports a negative cycle, all but map have to. Records throughputs
+// in `measured` and returns whether every engine passed.
+bool CheckCase(const Case& bench_case, const VertexDictionary& vertices, const BenchmarkOptions& options,
+               const std::map<std::string, double>& baseline, std::map<std::string, double>& measured,
+               CheckReport& report) {
+    std::vector<CheckedRun> runs;
+    for (const auto& engine : options.engines) {
+        if ((engine == "map" && bench_case.vertices > CHECK_MAP_MAX_VERTICES)
+            || (engine == "fixed" && bench_case.vertices > FIXED_MAX_VERTICES)) {
+            continue;
+        }
+        std::cerr << "checking " << engine << " on " << bench_case.graph << " (V=" << bench_case.vertices
+                  << ", E=" << bench_case.edges << ")" << std::endl;
+        CheckedRun& run = runs.emplace_back();
+        run.engine = engine;
+        if (engine == "map") {
+            CheckedMapSolve(bench_case, vertices, options, run);
+            continue;
+        }
+        const DenseOptions dense = EngineOptions(engine, options);
+        WithWeightType(bench_case.weight, [&](auto type) {
+            using Weight = typename decltype(type)::type;
+            const auto load = [&] {
+                return LoadEdgeList(bench_case.input_path, dense.threads);
+            };
+            if (engine == "johnson") {
+                CheckedSolve<Weight>(options, run, [&] { return Johnson<Weight>(load(), dense); });
+            }
+            else if (engine == "fixed") {
+                CheckedSolve<Weight>(options, run, [&] { return SmallFloydWarshall<Weight>(load(), dense); });
+            }
+            else if (engine == "external") {
+                CheckedSolve<Weight>(options, run, [&] {
+                    return OutOfCoreFloydWarshall<Weight>(load(), CHECK_TILE_FILE, dense);
+                });
+            }
+            else {
+                CheckedSolve<Weight>(options, run, [&] { return DenseFloydWarshall<Weight>(load(), dense); });
+            }
+        });
+    }
+
+    const bool negative_cycle = std::any_of(runs.begin(), runs.end(), [](const CheckedRun& run) {
+        return run.negative_cycle;
+    });
+    const std::size_t n = vertices.size();
+    bool passed = true;
+    for (const CheckedRun& run : runs) {
+        std::string result = "ok";
+        if (negative_cycle) {
+            result = run.engine == "map" ? "skipped" : run.negative_cycle ? "ok" : "missed-negative-cycle";
+        }
+        else {
+            for (std::size_t cell = 0; cell < n * n && result == "ok"; ++cell) {
+                if (cell / n != cell % n && !SameDistance(run.dist[cell], runs.front().dist[cell])) {
+                    result = "wrong-distance";
+                    std::cerr << run.engine << " on " << bench_case.graph << ": " << vertices.Name(cell / n)
+                              << " -> " << vertices.Name(cell % n) << " is " << run.dist[cell] << ", "
+                              << runs.front().engine << " gives " << runs.front().dist[cell] << std::endl;
+                }
+            }
+        }
+
+        double throughput = 0;
+        double expected = 0;
+        if (!run.solve_ms.empty()) {
+            const double median = Summarize(run.solve_ms).median;
+            throughput = NominalRelaxations(run.engine, bench_case) / (std::max(median, 1e-6) / 1000);
+        }
+        if (!run.solve_ms.empty() && Summarize(run.solve_ms).median >= CHECK_MIN_SOLVE_MS) {
+            const std::string key = BaselineKey(run.engine, bench_case);
+            measured[key] = throughput;
+            const auto it = baseline.find(key);
+            if (it != baseline.end()) {
+                expected = it->second;
+                if (throughput < expected * (1 - options.tolerance) && result == "ok") {
+                    result = "regressed";
+                }
+            }
+        }
+        passed = passed && (result == "ok" || result == "skipped");
+        report.Add(run, bench_case, result, throughput, expected);
+    }
+    return passed;
+}
+
+// Calls func(case, graph) for each generated graph of the --vertices and
+// --densities sweep, written to the scratch input file in turn.
+template<typename Func>
+void ForEachSyntheticCase(const BenchmarkOptions& options, int32_t potential_range, Func&& func) {
+    const std::string path = "input/" + SCRATCH_FILE;
+    for (std::size_t vertices : options.vertices) {
+        for (double density : options.densities) {
+            GraphSpec spec;
+            spec.vertices = vertices;
+            spec.density = density;
+            spec.potential_range = potential_range;
+            spec.seed = options.seed;
+            const EdgeList graph = GenerateGraph(spec);
+            WriteTextEdgeList(graph, path);
+            std::ostringstream name;
+            name << "synthetic-d" << density;
+            func(MakeCase(name.str(), path, graph, options.weight), graph);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+// The text fixtures in input/, in name order.
+std::vector<std::string> FixtureInputs() {
+    std::vector<std::string> inputs;
+    for (const auto& entry : std::filesystem::directory_iterator("input")) {
+        const std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && entry.path().extension() == ".txt" && name != SCRATCH_FILE) {
+            inputs.push_back(name);
+        }
+    }
+    std::sort(inputs.begin(), inputs.end());
+    return inputs;
+}
+
+// The --check suite; returns whether every engine passed on every case.
+bool RunChecks(const BenchmarkOptions& options, std::ostream& out) {
+    const std::map<std::string, double> baseline =
+        options.baseline.empty() ? std::map<std::string, double>() : ReadBaseline(options.baseline);
+    std::map<std::string, double> measured;
+    bool passed = true;
+    {
+        CheckReport report(out);
+        for (const auto& input : options.inputs.empty() ? FixtureInputs() : options.inputs) {
+            const std::string path = "input/" + input;
+            const EdgeList graph = LoadEdgeList(path);
+            passed = CheckCase(MakeCase(input, path, graph, options.weight), graph.vertices, options, baseline,
+                               measured, report) && passed;
+        }
+        if (options.inputs.empty()) {
+            // Reloaded, since the map engine only sees the vertices that the
+            // text file has edges for.
+            ForEachSyntheticCase(options, CHECK_POTENTIAL_RANGE, [&](const Case& bench_case, const EdgeList&) {
+                const EdgeList graph = LoadEdgeList(bench_case.input_path);
+                passed = CheckCase(MakeCase(bench_case.graph, bench_case.input_path, graph, options.weight),
+                                   graph.vertices, options, baseline, measured, report) && passed;
+            });
+        }
+    }
+
+    if (!options.save_baseline.empty()) {
+        std::ofstream file(options.save_baseline);
+        if (!file) {
+            throw std::runtime_error("Cannot open " + options.save_baseline + " for writing");
+        }
+        file << "engine,graph,vertices,relaxations_per_s\n";
+        for (const auto& [key, throughput] : measured) {
+            file << key << ',' << throughput << '\n';
+        }
+    }
+    std::cerr << (passed ? "All checks passed" : "Some checks failed") << std::endl;
+    return passed;
+}
+
+void PrintUsage() {
+    std::cerr << "Usage: benchmark [options]\n"
+              << "  --engines=dense,tiled,johnson,map,gpu,components,scalar,threaded\n"
+              << "                         and, with --check, fixed,external\n"
+              << "  --vertices=256,512,1024\n"
+              << "  --densities=0.01,0.1,0.5\n"
+              << "  --inputs=a.txt,b.txt   files under input/ instead of the synthetic sweep\n"
+              << "  --repeats=N --warmup=N --threads=N --seed=N\n"
+              << "  --weight=auto|int32|float|double\n"
+              << "  --format=csv|json\n"
+              << "  --output=FILE\n"
+              << "  --check [--baseline=FILE] [--save-baseline=FILE] [--tolerance=P]\n"
+              << "                         check every engine's distances against the reference and its\n"
+              << "                         throughput against the baseline instead of timing phases" << std::endl;
+}
+
+std::vector<std::string> SplitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool ParseOptions(int argc, char* argv[], BenchmarkOptions& options) {
+    bool engines_given = false;
+    bool vertices_given = false;
+    bool densities_given = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const std::size_t eq = arg.find('=');
+        const std::string name = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (name == "--engines") {
+            engines_given = true;
+            options.engines = SplitList(value);
+            for (const auto& engine : options.engines) {
+                if (engine != "map" && engine != "dense" && engine != "tiled" && engine != "johnson" && engine != "gpu"
+                    && engine != "components" && engine != "scalar" && engine != "threaded" && engine != "fixed"
+                    && engine != "external") {
+                    return false;
+                }
+            }
+        }
+        else if (name == "--vertices") {
+            vertices_given = true;
+            options.vertices.clear();
+            for (const auto& item : SplitList(value)) {
+                std::size_t count;
+                if (!ParseCount(item, count)) {
+                    return false;
+                }
+                options.vertices.push_back(count);
+            }
+        }
+        else if (name == "--densities") {
+            densities_given = true;
+            options.densities.clear();
+            for (const auto& item : SplitList(value)) {
+                double density;
+                if (!ParseDensity(item, density)) {
+                    return false;
+                }
+                options.densities.push_back(density);
+            }
+        }
+        else if (name == "--inputs") {
+            options.inputs = SplitList(value);
+        }
+        else if (name == "--repeats") {
+            if (!ParseCount(value, options.repeats) || options.repeats == 0) {
+                return false;
+            }
+        }
+        else if (name == "--warmup") {
+            if (!ParseCount(value, options.warmup)) {
+                return false;
+            }
+        }
+        else if (name == "--threads") {
+            if (!ParseCount(value, options.threads)) {
+                return false;
+            }
+        }
+        else if (name == "--seed") {
+            std::size_t seed;
+            if (!ParseCount(value, seed)) {
+                return false;
+            }
+            options.seed = seed;
+        }
+        else if (name == "--weight") {
+            if (!ParseWeightType(value, options.weight)) {
+                return false;
+            }
+        }
+        else if (name == "--format") {
+            if (value != "csv" && value != "json") {
+                return false;
+            }
+            options.json = value == "json";
+        }
+        else if (name == "--output") {
+            options.output = value;
+        }
+        else if (arg == "--check") {
+            options.check = true;
+        }
+        else if (name == "--baseline") {
+            options.baseline = value;
+        }
+        else if (name == "--save-baseline") {
+            options.save_baseline = value;
+        }
+        else if (name == "--tolerance") {
+            if (!ParseNonNegative(value, options.tolerance)) {
+                std::cerr << "--tolerance takes a non-negative fraction of the baseline throughput, e.g. 0.25"
+                          << std::endl;
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+    }
+
+    if (options.check) {
+        if (!engines_given) {
+            options.engines = CheckEngines();
+        }
+        if (!vertices_given) {
+            options.vertices = CHECK_VERTICES;
+        }
+        if (!densities_given) {
+            options.densities = CHECK_DENSITIES;
+        }
+        return !options.json && !options.engines.empty();
+    }
+    // Only --check reads results back from the fixed and external engines.
+    const bool check_only = std::any_of(options.engines.begin(), options.engines.end(), [](const std::string& engine) {
+        return engine == "fixed" || engine == "external";
+    });
+    return options.baseline.empty() && options.save_baseline.empty() && !check_only;
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::ofstream output_file;
+    if (!options.output.empty()) {
+        output_file.open(options.output);
+        if (!output_file) {
+            std::cerr << "Cannot open " << options.output << " for writing" << std::endl;
+            return 1;
+        }
+    }
+
+    bool passed = true;
+    try {
+        std::ostream& out = options.output.empty() ? std::cout : output_file;
+        if (options.check) {
+            passed = RunChecks(options, out);
+        }
+        else if (!options.inputs.empty()) {
+            Report report(out, options.json);
+            for (const auto& input : options.inputs) {
+                const std::string path = "input/" + input;
+                RunCase(MakeCase(input, path, LoadEdgeList(path), options.weight), options, report);
+            }
+        }
+        else {
+            Report report(out, options.json);
+            ForEachSyntheticCase(options, 0, [&](const Case& bench_case, const EdgeList&) {
+                RunCase(bench_case, options, report);
+            });
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        std::remove(("input/" + SCRATCH_FILE).c_str());
+        std::remove(("output/" + SCRATCH_FILE).c_str());
+        return 1;
+    }
+    std::remove(("output/" + SCRATCH_FILE).c_str());
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "edge_list.h"
+#include "relax_kernels.h"
+
+// Option value parsers shared by the command-line tools.
+inline bool ParseCount(const std::string& text, std::size_t& value) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+inline bool ParseInt32(const std::string& text, int32_t& value) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+// A probability in [0, 1].
+inline bool ParseDensity(const std::string& text, double& value) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end && value >= 0 && value <= 1;
+}
+
+// A finite number >= 0.
+inline bool ParseNonNegative(const std::string& text, double& value) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end && std::isfinite(value) && value >= 0;
+}
+
+// Comma-separated names, none of them empty.
+inline bool ParseNameList(const std::string& text, std::vector<std::string>& names) {
+    names.clear();
+    std::size_t begin = 0;
+    for (;;) {
+        const std::size_t end = std::min(text.find(',', begin), text.size());
+        if (end == begin) {
+            return false;
+        }
+        names.push_back(text.substr(begin, end - begin));
+        if (end == text.size()) {
+            return true;
+        }
+        begin = end + 1;
+    }
+}
+
+inline bool ParseSimdLevel(const std::string& text, SimdLevel& level) {
+    if (text == "auto") {
+        level = SimdLevel::Auto;
+    }
+    else if (text == "scalar") {
+        level = SimdLevel::Scalar;
+    }
+    else if (text == "avx2") {
+        level = SimdLevel::Avx2;
+    }
+    else if (text == "avx512") {
+        level = SimdLevel::Avx512;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+inline bool ParseWeightType(const std::string& text, WeightType& weight) {
+    if (text == "auto") {
+        weight = WeightType::Auto;
+    }
+    else if (text == "int32") {
+        weight = WeightType::Int32;
+    }
+    else if (text == "float") {
+        weight = WeightType::Float;
+    }
+    else if (text == "double") {
+        weight = WeightType::Double;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
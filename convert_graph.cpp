@@ -0,0 +1,23 @@
+#include <iostream>
+#include <string>
+
+#include "edge_list.h"
+
+// Converts a text edge list into the binary format read by LoadEdgeList.
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: convert_graph <TextEdgeList> <BinaryEdgeList>" << std::endl;
+        return 1;
+    }
+
+    try {
+        const EdgeList graph = LoadEdgeList(argv[1], 0);
+        WriteBinaryEdgeList(graph, argv[2]);
+        std::cout << graph.vertices.size() << " vertices, " << graph.Edges().size() << " edges" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
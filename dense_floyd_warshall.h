@@ -0,0 +1,1094 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#include "distance_writer.h"
+#include "edge_list.h"
+#include "floyd_warshall.h"
+#include "gpu_floyd_warshall.h"
+#include "instrumentation.h"
+#include "relax_kernels.h"
+#include "result_matrix.h"
+#include "strong_components.h"
+#include "thread_pool.h"
+#include "vertex_dictionary.h"
+#include "weight_traits.h"
+
+// Thrown by the dense solver as soon as a vertex is found on a negative
+// cycle; carries the names of the vertices known to lie on one at that point
+// (the whole cycle when successors are tracked).
+class NegativeCycleException : public CycleDetectedException {
+public:
+    explicit NegativeCycleException(std::vector<std::string> vertices)
+        : vertices_(std::move(vertices)), message_("Negative cycle detected through vertices:") {
+        for (const auto& vertex : vertices_) {
+            message_ += " " + vertex;
+        }
+    }
+
+    const char* what() const noexcept override {
+        return message_.c_str();
+    }
+
+    const std::vector<std::string>& Vertices() const {
+        return vertices_;
+    }
+
+private:
+    std::vector<std::string> vertices_;
+    std::string message_;
+};
+
+// One change for DenseFloydWarshall::UpdateEdges: the edge from -> to gets
+// `weight`, replacing any edge already there; +infinity removes it.
+struct EdgeUpdate {
+    VertexDictionary::Id from;
+    VertexDictionary::Id to;
+    double weight;
+};
+
+enum class DenseKernel {
+    Naive,
+    Blocked,
+    // The blocked kernel on a CUDA device, see gpu_floyd_warshall.h; runs
+    // Blocked on the CPU when no device (or not enough device memory) is
+    // available or the build has no CUDA support.
+    Gpu,
+    // Solves every strongly connected component on its own and combines
+    // them along the condensation DAG, so pairs that cannot reach each other
+    // are never relaxed. Pays off on loosely connected graphs.
+    Components,
+};
+
+enum class NegativeCyclePolicy {
+    // Abort the solve with NegativeCycleException.
+    Fail,
+    // Finish the solve and report every pair that can reach through a
+    // negative cycle as -INF.
+    Mark,
+};
+
+struct DenseOptions {
+    DenseKernel kernel = DenseKernel::Naive;
+    // Edge length of the square tiles used by the blocked kernel; 0 picks a
+    // size from the L2 cache.
+    std::size_t tile_size = 0;
+    SimdLevel simd = SimdLevel::Auto;
+    // Worker threads for the solve, including the calling one; 0 uses every
+    // hardware thread.
+    std::size_t threads = 1;
+    // When false no successor matrix is allocated or updated and only
+    // distances are printed.
+    bool track_paths = true;
+    NegativeCyclePolicy negative_cycles = NegativeCyclePolicy::Fail;
+};
+
+// Same algorithm as FloydWarshall, but vertex names are interned into dense
+// ids once while loading and the solver works on row-major V*V matrices.
+// Names are only looked up again when the result is printed. Weight is the
+// type distances are stored and added in, see WeightTraits.
+template<typename Weight = double>
+class DenseFloydWarshall {
+public:
+    using Traits = WeightTraits<Weight>;
+
+    DenseFloydWarshall(const std::string& file_name, const DenseOptions& options = {})
+        : DenseFloydWarshall(LoadEdgeList("input/" + file_name, options.threads), options) {
+    }
+
+    DenseFloydWarshall(EdgeList graph, const DenseOptions& options = {})
+        : options_(options),
+          relax_row_(SelectRelaxRow<Weight>(options.simd, options.track_paths)),
+          relax_columns_(SelectRelaxColumns<Weight>(options.track_paths)) {
+        InitEdges(std::move(graph));
+        InitDistanceMatrix();
+    }
+
+    void GenerateDistanceMatrix() {
+        FW_PHASE(Phase::GenerateDistanceMatrix);
+        if (options_.threads != 1 && !pool_) {
+            pool_ = std::make_unique<ThreadPool>(options_.threads);
+        }
+
+        const std::size_t n = vertices_.size();
+        const std::size_t device_bytes = n * n * (sizeof(Weight) + (options_.track_paths ? sizeof(int32_t) : 0));
+        if (options_.kernel == DenseKernel::Naive) {
+            GenerateNaive();
+            MarkUnboundedPairs();
+            solved_ = true;
+            return;
+        }
+
+        if (options_.kernel == DenseKernel::Gpu && GpuAvailable(device_bytes)) {
+            GpuFloydWarshall(dist_matrix_.data(), options_.track_paths ? next_vertex_.data() : nullptr, n);
+            // The device cannot stop at the first negative cycle, so it is
+            // looked for once the whole solve is back.
+            CheckNegativeCycle(0, n);
+        }
+        else if (options_.kernel == DenseKernel::Components) {
+            GenerateComponents();
+        }
+        else {
+            GenerateBlocked(options_.tile_size ? options_.tile_size : AutoTileSize(), 0, n);
+        }
+        MarkUnboundedPairs();
+        if (options_.track_paths) {
+            RepairSuccessors();
+        }
+        solved_ = true;
+    }
+
+    // Lowers the edge from -> to to `weight`, or inserts it, on a solved
+    // instance. Every pair that improves does so through the new edge, so
+    // one pass of dist[i][j] = min(dist[i][j], dist[i][from] + weight +
+    // dist[to][j]) repairs the matrices in O(V^2).
+    void DecreaseEdge(VertexDictionary::Id from, VertexDictionary::Id to, double weight) {
+        RequireSolved();
+        const Weight old_weight = EdgeWeight(from, to);
+        if (CheckedWeight(weight) > old_weight) {
+            throw std::invalid_argument("DecreaseEdge cannot raise an edge weight");
+        }
+        RepairDecrease(from, to, CheckedWeight(weight));
+        SetEdge(from, to, weight);
+    }
+
+    // Applies a batch of arbitrary edge changes; later entries for the same
+    // pair win. Raised and removed edges go first: only rows with a shortest
+    // path through one of them can change, and those rows are rebuilt from
+    // their out-edges and the untouched rows. Lowered and new edges are then
+    // repaired one by one as in DecreaseEdge. Once the matrix holds
+    // unbounded pairs, from before the batch or from a lowered edge that
+    // closed a negative cycle, the rest of the batch is applied and the whole
+    // graph is solved again instead. When a lowered edge throws
+    // NegativeCycleException the updates before it stay applied.
+    void UpdateEdges(std::span<const EdgeUpdate> updates) {
+        RequireSolved();
+        const std::size_t n = vertices_.size();
+        std::vector<EdgeUpdate> latest(updates.begin(), updates.end());
+        for (const EdgeUpdate& update : latest) {
+            if (update.from >= n || update.to >= n) {
+                throw std::out_of_range("Unknown vertex in edge update");
+            }
+            if (update.weight != std::numeric_limits<double>::infinity()) {
+                CheckedWeight(update.weight);
+            }
+        }
+        std::stable_sort(latest.begin(), latest.end(), [](const EdgeUpdate& lhs, const EdgeUpdate& rhs) {
+            return lhs.from != rhs.from ? lhs.from < rhs.from : lhs.to < rhs.to;
+        });
+
+        std::vector<EdgeUpdate> decreases;
+        std::vector<char> affected(n);
+        bool any_affected = false;
+        for (std::size_t u = 0; u < latest.size(); ++u) {
+            const EdgeUpdate& update = latest[u];
+            if (u + 1 < latest.size() && latest[u + 1].from == update.from && latest[u + 1].to == update.to) {
+                continue;
+            }
+            const Weight old_weight = EdgeWeight(update.from, update.to);
+            const Weight new_weight = update.weight == std::numeric_limits<double>::infinity()
+                ? Traits::Infinity() : static_cast<Weight>(update.weight);
+            if (new_weight < old_weight) {
+                decreases.push_back(update);
+            }
+            else if (new_weight > old_weight) {
+                if (update.from != update.to && !has_unbounded_) {
+                    any_affected |= MarkRowsUsingEdge(update.from, update.to, old_weight, affected);
+                }
+                SetEdge(update.from, update.to, update.weight);
+            }
+        }
+
+        std::size_t repaired = 0;
+        if (!has_unbounded_) {
+            if (any_affected) {
+                RecomputeRows(affected);
+            }
+            for (; repaired < decreases.size() && !has_unbounded_; ++repaired) {
+                const EdgeUpdate& update = decreases[repaired];
+                RepairDecrease(update.from, update.to, static_cast<Weight>(update.weight));
+                SetEdge(update.from, update.to, update.weight);
+            }
+            if (repaired == decreases.size()) {
+                return;
+            }
+        }
+        for (; repaired < decreases.size(); ++repaired) {
+            SetEdge(decreases[repaired].from, decreases[repaired].to, decreases[repaired].weight);
+        }
+        InitDistanceMatrix();
+        GenerateDistanceMatrix();
+    }
+
+    // Throws std::invalid_argument if UpdateEdges would reject `weight`.
+    void CheckWeight(double weight) const {
+        CheckedWeight(weight);
+    }
+
+    const VertexDictionary& Vertices() const {
+        return vertices_;
+    }
+
+    // Row-major V*V matrices of the last solve; Successors() is empty when
+    // paths are not tracked.
+    std::span<const Weight> Distances() const {
+        return dist_matrix_;
+    }
+
+    std::span<const int32_t> Successors() const {
+        return next_vertex_;
+    }
+
+    // Vertices on the shortest path from -> to, walked lazily over the
+    // successor matrix; empty when there is none or paths are not tracked.
+    PathRange Path(VertexDictionary::Id from, VertexDictionary::Id to) const {
+        return MatrixPath<Weight>(vertices_.size(), dist_matrix_, next_vertex_, from, to);
+    }
+
+    DistanceMatrixView<Weight> Result() const {
+        return { vertices_, dist_matrix_, next_vertex_ };
+    }
+
+    void PrintDistances(const std::string& file_name) const {
+        PrintDistanceMatrix<Weight>("output/" + file_name, Result());
+    }
+
+    // Dumps the matrices in the binary format of result_matrix.h.
+    void SaveResultMatrix(const std::string& file_name) const {
+        WriteResultMatrix<Weight>("output/" + file_name, Result());
+    }
+
+private:
+    // Pivot rows with fewer than one finite entry in this many are applied
+    // through their column list.
+    static constexpr std::size_t SPARSE_PIVOT_RATIO = 8;
+
+    DenseOptions options_;
+    RelaxRowFn<Weight> relax_row_;
+    RelaxColumnsFn<Weight> relax_columns_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::vector<Weight> dist_matrix_;
+    std::vector<int32_t> next_vertex_;
+    struct Arc {
+        uint32_t to;
+        double weight;
+    };
+
+    VertexDictionary vertices_;
+    EdgeList edges_;
+    // Out-edges sorted by target, built from edges_ on the first update and
+    // the source of truth for the graph from then on.
+    std::vector<std::vector<Arc>> out_arcs_;
+    bool solved_ = false;
+    bool has_unbounded_ = false;
+    // While GenerateComponents has the matrices renumbered, the original id
+    // of every vertex; empty otherwise.
+    std::vector<uint32_t> solve_order_;
+
+    // The edges stay in the loaded EdgeList so a mapped binary graph is read
+    // in place; only its dictionary moves out. They are kept after the solve
+    // for re-runs of the kernel and for edge updates.
+    void InitEdges(EdgeList graph) {
+        FW_PHASE(Phase::InitEdges);
+        vertices_ = std::move(graph.vertices);
+        edges_ = std::move(graph);
+    }
+
+    template<typename Func>
+    void ForEachEdge(Func&& func) const {
+        if (out_arcs_.empty()) {
+            for (const Edge& edge : edges_.Edges()) {
+                func(edge.from, edge.to, edge.weight);
+            }
+            return;
+        }
+        for (std::size_t from = 0; from < out_arcs_.size(); ++from) {
+            for (const Arc& arc : out_arcs_[from]) {
+                func(static_cast<uint32_t>(from), arc.to, arc.weight);
+            }
+        }
+    }
+
+    void InitDistanceMatrix() {
+        FW_PHASE(Phase::InitDistanceMatrix);
+        const std::size_t n = vertices_.size();
+        dist_matrix_.assign(n * n, Traits::Infinity());
+        if (options_.track_paths) {
+            next_vertex_.assign(n * n, -1);
+        }
+
+        ForEachEdge([&](uint32_t from, uint32_t to, double weight) {
+            dist_matrix_[from * n + to] = static_cast<Weight>(weight);
+            if (options_.track_paths) {
+                next_vertex_[from * n + to] = static_cast<int32_t>(to);
+            }
+        });
+        for (std::size_t v = 0; v < n; ++v) {
+            dist_matrix_[v * n + v] = 0;
+        }
+        solved_ = false;
+        has_unbounded_ = false;
+    }
+
+    void RequireSolved() const {
+        if (!solved_) {
+            throw std::logic_error("Edge updates need a solved distance matrix");
+        }
+    }
+
+    // The weight as stored in the matrix; rejects values the weight type
+    // cannot hold exactly, since the instance was sized for the loaded graph.
+    // In int32 it also rejects weights of which V - 1 could overflow a path
+    // sum, the bound NarrowestWeightType picks int32 by: such sums would
+    // saturate to INF.
+    Weight CheckedWeight(double weight) const {
+        const Weight stored = static_cast<Weight>(weight);
+        if (!std::isfinite(weight) || static_cast<double>(stored) != weight || stored == Traits::Infinity()
+            || stored == Traits::NegativeInfinity()) {
+            throw std::invalid_argument("Edge weight is not representable in the solver's weight type");
+        }
+        if constexpr (std::is_integral_v<Weight>) {
+            const double longest = static_cast<double>(std::max<std::size_t>(vertices_.size(), 2) - 1);
+            if (std::abs(weight) * longest >= static_cast<double>(Traits::Infinity())) {
+                throw std::invalid_argument("Edge weight could overflow a path sum in the solver's weight type");
+            }
+        }
+        return stored;
+    }
+
+    void BuildArcs() {
+        if (!out_arcs_.empty()) {
+            return;
+        }
+        std::vector<Edge> edges(edges_.Edges().begin(), edges_.Edges().end());
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge& lhs, const Edge& rhs) {
+            return lhs.from != rhs.from ? lhs.from < rhs.from : lhs.to < rhs.to;
+        });
+        out_arcs_.resize(vertices_.size());
+        for (std::size_t e = 0; e < edges.size(); ++e) {
+            if (e + 1 < edges.size() && edges[e + 1].from == edges[e].from && edges[e + 1].to == edges[e].to) {
+                continue;
+            }
+            out_arcs_[edges[e].from].push_back({ edges[e].to, edges[e].weight });
+        }
+        edges_ = EdgeList();
+    }
+
+    // Weight of the edge from -> to, infinity if there is none.
+    Weight EdgeWeight(VertexDictionary::Id from, VertexDictionary::Id to) {
+        if (from >= vertices_.size() || to >= vertices_.size()) {
+            throw std::out_of_range("Unknown vertex in edge update");
+        }
+        BuildArcs();
+        const auto& arcs = out_arcs_[from];
+        auto it = std::lower_bound(arcs.begin(), arcs.end(), to, [](const Arc& arc, uint32_t target) {
+            return arc.to < target;
+        });
+        return it != arcs.end() && it->to == to ? static_cast<Weight>(it->weight) : Traits::Infinity();
+    }
+
+    void SetEdge(VertexDictionary::Id from, VertexDictionary::Id to, double weight) {
+        BuildArcs();
+        auto& arcs = out_arcs_[from];
+        auto it = std::lower_bound(arcs.begin(), arcs.end(), to, [](const Arc& arc, uint32_t target) {
+            return arc.to < target;
+        });
+        const bool present = it != arcs.end() && it->to == to;
+        if (weight == std::numeric_limits<double>::infinity()) {
+            if (present) {
+                arcs.erase(it);
+            }
+        }
+        else if (present) {
+            it->weight = weight;
+        }
+        else {
+            arcs.insert(it, { to, weight });
+        }
+    }
+
+    // Propagates a lowered edge a -> b. If it closes a negative cycle the
+    // policy applies: Fail throws before anything changes, Mark sets every
+    // pair that reaches through the edge to -INF.
+    void RepairDecrease(std::size_t a, std::size_t b, Weight weight) {
+        const std::size_t n = vertices_.size();
+        // Self-loops never enter the matrix (dist[v][v] is 0), as in a full
+        // solve.
+        if (a == b) {
+            return;
+        }
+
+        const Weight b_a = dist_matrix_[b * n + a];
+        if (b_a != Traits::Infinity() && Traits::Add(b_a, weight) < 0) {
+            if (options_.negative_cycles == NegativeCyclePolicy::Fail) {
+                std::vector<std::string> on_cycle;
+                on_cycle.emplace_back(vertices_.Name(a));
+                std::size_t current = b;
+                for (std::size_t steps = 0; steps < n && current != a; ++steps) {
+                    on_cycle.emplace_back(vertices_.Name(current));
+                    if (!options_.track_paths) {
+                        break;
+                    }
+                    current = static_cast<std::size_t>(next_vertex_[current * n + a]);
+                }
+                throw NegativeCycleException(std::move(on_cycle));
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                if (dist_matrix_[i * n + a] == Traits::Infinity()) {
+                    continue;
+                }
+                for (std::size_t j = 0; j < n; ++j) {
+                    if (dist_matrix_[b * n + j] != Traits::Infinity()) {
+                        dist_matrix_[i * n + j] = Traits::NegativeInfinity();
+                    }
+                }
+            }
+            has_unbounded_ = true;
+            return;
+        }
+
+        ParallelFor(n, [&](std::size_t i) {
+            const Weight i_a = dist_matrix_[i * n + a];
+            if (i_a == Traits::Infinity()) {
+                return;
+            }
+            const Weight via = Traits::Add(i_a, weight);
+            const int32_t first_hop = i == a ? static_cast<int32_t>(b) : (options_.track_paths ? next_vertex_[i * n + a] : -1);
+            Weight* row_i = &dist_matrix_[i * n];
+            const Weight* row_b = &dist_matrix_[b * n];
+            for (std::size_t j = 0; j < n; ++j) {
+                // Unbounded pairs stay so; through an unbounded pair, Add
+                // yields -INF.
+                if (row_b[j] == Traits::Infinity() || row_i[j] == Traits::NegativeInfinity()) {
+                    continue;
+                }
+                const Weight candidate = Traits::Add(via, row_b[j]);
+                if (candidate < row_i[j]) {
+                    row_i[j] = candidate;
+                    if (options_.track_paths) {
+                        next_vertex_[i * n + j] = first_hop;
+                    }
+                }
+            }
+        });
+    }
+
+    // Sums of floating weights can come out a few ulps apart depending on
+    // the order they were added in, so ties are matched with some slack;
+    // a false match only costs the recomputation of one more row.
+    static bool NotLonger(Weight through, Weight best) {
+        if constexpr (std::is_integral_v<Weight>) {
+            return through <= best;
+        }
+        else {
+            return through <= best + std::abs(best) * 64 * std::numeric_limits<Weight>::epsilon();
+        }
+    }
+
+    // Flags every row i with a shortest path, to any target, that uses the
+    // edge a -> b of weight `weight`. Returns whether any row was flagged.
+    bool MarkRowsUsingEdge(std::size_t a, std::size_t b, Weight weight, std::vector<char>& affected) const {
+        const std::size_t n = vertices_.size();
+        bool any = false;
+        const Weight* row_b = &dist_matrix_[b * n];
+        for (std::size_t i = 0; i < n; ++i) {
+            const Weight i_a = dist_matrix_[i * n + a];
+            if (affected[i] || i_a == Traits::Infinity()) {
+                continue;
+            }
+            const Weight via = Traits::Add(i_a, weight);
+            const Weight* row_i = &dist_matrix_[i * n];
+            for (std::size_t j = 0; j < n; ++j) {
+                if (row_b[j] != Traits::Infinity() && row_i[j] != Traits::Infinity()
+                    && NotLonger(Traits::Add(via, row_b[j]), row_i[j])) {
+                    affected[i] = true;
+                    any = true;
+                    break;
+                }
+            }
+        }
+        return any;
+    }
+
+    // Rebuilds the flagged rows from dist[i][j] = min over edges i -> k of
+    // w(i, k) + dist[k][j], starting from nothing and iterating to the fixed
+    // point like Bellman-Ford over rows; the other rows are already exact.
+    void RecomputeRows(const std::vector<char>& affected) {
+        const std::size_t n = vertices_.size();
+        std::vector<std::size_t> rows;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (affected[i]) {
+                rows.push_back(i);
+                std::fill(dist_matrix_.begin() + i * n, dist_matrix_.begin() + (i + 1) * n, Traits::Infinity());
+                dist_matrix_[i * n + i] = 0;
+                if (options_.track_paths) {
+                    std::fill(next_vertex_.begin() + i * n, next_vertex_.begin() + (i + 1) * n, -1);
+                }
+            }
+        }
+
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (std::size_t i : rows) {
+                Weight* row_i = &dist_matrix_[i * n];
+                for (const Arc& arc : out_arcs_[i]) {
+                    if (arc.to == i) {
+                        continue;
+                    }
+                    const Weight weight = static_cast<Weight>(arc.weight);
+                    const Weight* row_k = &dist_matrix_[arc.to * n];
+                    for (std::size_t j = 0; j < n; ++j) {
+                        if (j == i || row_k[j] == Traits::Infinity()) {
+                            continue;
+                        }
+                        const Weight candidate = Traits::Add(weight, row_k[j]);
+                        if (candidate < row_i[j]) {
+                            row_i[j] = candidate;
+                            if (options_.track_paths) {
+                                next_vertex_[i * n + j] = static_cast<int32_t>(arc.to);
+                            }
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Out-of-order pivots can close successor loops on zero-weight cycles:
+    // the distances are right, but the walk towards some target never gets
+    // there. The walks towards every target are followed once, reusing the
+    // vertices already known to arrive, in O(V^2); only the columns with a
+    // loop are repaired, see RepairColumn.
+    void RepairSuccessors() {
+        const std::size_t n = vertices_.size();
+        std::vector<char> state(n);
+        std::vector<std::size_t> walk;
+        // In-edges, with Arc::to naming the source; built on the first repair.
+        std::vector<std::vector<Arc>> in_arcs;
+        for (std::size_t j = 0; j < n; ++j) {
+            std::fill(state.begin(), state.end(), WALK_UNSEEN);
+            state[j] = WALK_ARRIVES;
+            bool loops = false;
+            for (std::size_t i = 0; i < n; ++i) {
+                walk.clear();
+                std::size_t current = i;
+                while (state[current] == WALK_UNSEEN && IsFinite(dist_matrix_[current * n + j])) {
+                    state[current] = WALK_OPEN;
+                    walk.push_back(current);
+                    current = static_cast<std::size_t>(next_vertex_[current * n + j]);
+                }
+                const char end = state[current] == WALK_ARRIVES ? WALK_ARRIVES : WALK_LOOPS;
+                for (std::size_t v : walk) {
+                    state[v] = end;
+                }
+                loops = loops || (!walk.empty() && end == WALK_LOOPS);
+            }
+            if (loops) {
+                RepairColumn(j, state, in_arcs);
+            }
+        }
+    }
+
+    static constexpr char WALK_UNSEEN = 0;
+    static constexpr char WALK_OPEN = 1;
+    static constexpr char WALK_ARRIVES = 2;
+    static constexpr char WALK_LOOPS = 3;
+
+    static bool IsFinite(Weight value) {
+        return value != Traits::Infinity() && value != Traits::NegativeInfinity();
+    }
+
+    // Gives every looping vertex of column j a new successor. The arriving
+    // set grows backwards along tight arcs, those with w(v, u) + dist[u][j]
+    // equal to dist[v][j]: each new successor already arrives, so no loop
+    // can close, and every looping vertex is reached, since the arcs of its
+    // shortest path to j are all tight. O(E).
+    void RepairColumn(std::size_t j, std::vector<char>& state, std::vector<std::vector<Arc>>& in_arcs) {
+        const std::size_t n = vertices_.size();
+        if (in_arcs.empty()) {
+            BuildArcs();
+            in_arcs.resize(n);
+            for (std::size_t from = 0; from < n; ++from) {
+                for (const Arc& arc : out_arcs_[from]) {
+                    if (arc.to != from) {
+                        in_arcs[arc.to].push_back({ static_cast<uint32_t>(from), arc.weight });
+                    }
+                }
+            }
+        }
+
+        std::vector<uint32_t> arrived;
+        for (std::size_t v = 0; v < n; ++v) {
+            if (state[v] == WALK_ARRIVES && IsFinite(dist_matrix_[v * n + j])) {
+                arrived.push_back(static_cast<uint32_t>(v));
+            }
+        }
+        for (std::size_t a = 0; a < arrived.size(); ++a) {
+            const uint32_t to = arrived[a];
+            for (const Arc& arc : in_arcs[to]) {
+                if (state[arc.to] == WALK_LOOPS
+                    && NotLonger(Traits::Add(static_cast<Weight>(arc.weight), dist_matrix_[to * n + j]),
+                                 dist_matrix_[arc.to * n + j])) {
+                    state[arc.to] = WALK_ARRIVES;
+                    next_vertex_[arc.to * n + j] = static_cast<int32_t>(to);
+                    arrived.push_back(arc.to);
+                }
+            }
+        }
+    }
+
+    std::size_t OriginalId(std::size_t v) const {
+        return solve_order_.empty() ? v : solve_order_[v];
+    }
+
+    // Every negative cycle shows up on the diagonal no later than right
+    // before its highest pivot is processed (or, for the blocked kernel, once
+    // the diagonal tile of its block is closed), so checking dist[k][k] for
+    // the pivots about to be used finds it at O(1) cost per pivot.
+    void CheckNegativeCycle(std::size_t k_begin, std::size_t k_end) const {
+        if (options_.negative_cycles != NegativeCyclePolicy::Fail) {
+            return;
+        }
+
+        const std::size_t n = vertices_.size();
+        for (std::size_t k = k_begin; k < k_end; ++k) {
+            if (dist_matrix_[k * n + k] < 0) {
+                std::vector<bool> affected(n);
+                for (std::size_t v = 0; v < n; ++v) {
+                    affected[OriginalId(v)] = dist_matrix_[v * n + v] < 0;
+                }
+                if (options_.track_paths) {
+                    std::size_t current = k;
+                    for (std::size_t steps = 0; steps < n && next_vertex_[current * n + k] >= 0; ++steps) {
+                        current = static_cast<std::size_t>(next_vertex_[current * n + k]);
+                        affected[OriginalId(current)] = true;
+                        if (current == k) {
+                            break;
+                        }
+                    }
+                }
+
+                std::vector<std::string> on_cycle;
+                for (std::size_t v = 0; v < n; ++v) {
+                    if (affected[v]) {
+                        on_cycle.emplace_back(vertices_.Name(v));
+                    }
+                }
+                throw NegativeCycleException(std::move(on_cycle));
+            }
+        }
+    }
+
+    // After a full solve the vertices on negative cycles are those with
+    // dist[k][k] < 0; every pair (i, j) with i reaching such a k and k
+    // reaching j has no shortest path. Rows are combined as bitsets, so this
+    // costs O(V^2 * C / 64) for C vertices on cycles.
+    void MarkUnboundedPairs() {
+        const std::size_t n = vertices_.size();
+        std::vector<std::size_t> on_cycle;
+        for (std::size_t k = 0; k < n; ++k) {
+            if (dist_matrix_[k * n + k] < 0) {
+                on_cycle.push_back(k);
+            }
+        }
+        if (on_cycle.empty()) {
+            return;
+        }
+        has_unbounded_ = true;
+
+        const std::size_t words = (n + 63) / 64;
+        std::vector<uint64_t> reach_from(on_cycle.size() * words, 0);
+        for (std::size_t c = 0; c < on_cycle.size(); ++c) {
+            const Weight* row_k = &dist_matrix_[on_cycle[c] * n];
+            for (std::size_t j = 0; j < n; ++j) {
+                if (row_k[j] != Traits::Infinity()) {
+                    reach_from[c * words + j / 64] |= uint64_t(1) << (j % 64);
+                }
+            }
+        }
+
+        std::vector<uint64_t> unbounded(words);
+        for (std::size_t i = 0; i < n; ++i) {
+            std::fill(unbounded.begin(), unbounded.end(), 0);
+            for (std::size_t c = 0; c < on_cycle.size(); ++c) {
+                if (dist_matrix_[i * n + on_cycle[c]] != Traits::Infinity()) {
+                    for (std::size_t w = 0; w < words; ++w) {
+                        unbounded[w] |= reach_from[c * words + w];
+                    }
+                }
+            }
+            for (std::size_t j = 0; j < n; ++j) {
+                if (unbounded[j / 64] >> (j % 64) & 1) {
+                    dist_matrix_[i * n + j] = Traits::NegativeInfinity();
+                }
+            }
+        }
+    }
+
+    // Relaxes dist[i][j] through every pivot k for i in [i_begin, i_end),
+    // j in [j_begin, j_end) and k in [k_begin, k_end), pivots in order.
+    void RelaxTile(std::size_t i_begin, std::size_t i_end, std::size_t j_begin, std::size_t j_end,
+                   std::size_t k_begin, std::size_t k_end) {
+        const std::size_t n = vertices_.size();
+        for (std::size_t k = k_begin; k < k_end; ++k) {
+            const Weight* row_k = &dist_matrix_[k * n];
+            for (std::size_t i = i_begin; i < i_end; ++i) {
+                const Weight i_k = dist_matrix_[i * n + k];
+                if (i_k == Traits::Infinity()) {
+                    continue;
+                }
+                int32_t* next_i = options_.track_paths ? &next_vertex_[i * n] : nullptr;
+                FW_COUNT(Counter::Relaxations, j_end - j_begin);
+                relax_row_(&dist_matrix_[i * n], next_i, row_k, i_k, next_i ? next_i[k] : -1, j_begin, j_end);
+            }
+        }
+    }
+
+    template<typename Func>
+    void ParallelFor(std::size_t count, Func&& func) {
+        if (pool_) {
+            pool_->ParallelFor(count, func);
+        }
+        else {
+            for (std::size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+        }
+    }
+
+    // Within one pivot k every row i != k only reads row k, so the listed
+    // rows are split into chunks and relaxed in parallel once row k itself
+    // is done.
+    void GenerateNaive() {
+        const std::size_t n = vertices_.size();
+        PivotLists pivot;
+        if (!pool_) {
+            for (std::size_t k = 0; k < n; ++k) {
+                CheckNegativeCycle(k, k + 1);
+                CollectPivot(k, 0, n, pivot);
+                RelaxPivotRows(k, pivot, 0, pivot.rows.size(), 0, n);
+            }
+            return;
+        }
+
+        for (std::size_t k = 0; k < n; ++k) {
+            CheckNegativeCycle(k, k + 1);
+            CollectPivot(k, 0, n, pivot);
+            const std::size_t rows = pivot.rows.size();
+            const std::size_t own = std::lower_bound(pivot.rows.begin(), pivot.rows.end(), k) - pivot.rows.begin();
+            RelaxPivotRows(k, pivot, own, own + 1, 0, n);
+            const std::size_t chunks = std::min(rows, pool_->size() * 4);
+            const std::size_t rows_per_chunk = (rows + chunks - 1) / chunks;
+            pool_->ParallelFor(chunks, [&](std::size_t chunk) {
+                const std::size_t first = chunk * rows_per_chunk;
+                const std::size_t last = std::min(first + rows_per_chunk, rows);
+                RelaxPivotRows(k, pivot, first, std::min(last, own), 0, n);
+                RelaxPivotRows(k, pivot, std::max(first, own + 1), last, 0, n);
+            });
+        }
+    }
+
+    // The rows i with a finite dist[i][k] and the columns j with a finite
+    // dist[k][j] of one pivot k; only those can take part in its updates.
+    // Relaxing through k cannot change which cells are finite, so the lists
+    // hold for the whole pivot.
+    struct PivotLists {
+        std::vector<uint32_t> rows;
+        std::vector<uint32_t> columns;
+    };
+
+    void CollectPivot(std::size_t k, std::size_t begin, std::size_t end, PivotLists& pivot) const {
+        const std::size_t n = vertices_.size();
+        const Weight* row_k = &dist_matrix_[k * n];
+        pivot.rows.clear();
+        pivot.columns.clear();
+        for (std::size_t v = begin; v < end; ++v) {
+            if (dist_matrix_[v * n + k] != Traits::Infinity()) {
+                pivot.rows.push_back(static_cast<uint32_t>(v));
+            }
+            if (row_k[v] != Traits::Infinity()) {
+                pivot.columns.push_back(static_cast<uint32_t>(v));
+            }
+        }
+    }
+
+    // Relaxes the listed rows [first, last) through pivot k over the
+    // columns [begin, end). A pivot row with few finite entries is applied
+    // through its column list, a denser one by the SIMD row kernel, which
+    // skips nothing but needs no indirection.
+    void RelaxPivotRows(std::size_t k, const PivotLists& pivot, std::size_t first, std::size_t last, std::size_t begin,
+                        std::size_t end) {
+        const std::size_t n = vertices_.size();
+        const bool sparse = pivot.columns.size() * SPARSE_PIVOT_RATIO < end - begin;
+        const Weight* row_k = &dist_matrix_[k * n];
+        for (std::size_t r = first; r < last; ++r) {
+            const std::size_t i = pivot.rows[r];
+            const Weight i_k = dist_matrix_[i * n + k];
+            int32_t* next_i = options_.track_paths ? &next_vertex_[i * n] : nullptr;
+            const int32_t next_ik = next_i ? next_i[k] : -1;
+            if (sparse) {
+                FW_COUNT(Counter::Relaxations, pivot.columns.size());
+                relax_columns_(&dist_matrix_[i * n], next_i, row_k, i_k, next_ik, pivot.columns.data(),
+                               pivot.columns.size());
+            }
+            else {
+                FW_COUNT(Counter::Relaxations, end - begin);
+                relax_row_(&dist_matrix_[i * n], next_i, row_k, i_k, next_ik, begin, end);
+            }
+        }
+    }
+
+    // Renumbers the vertices so that every strongly connected component is a
+    // contiguous range, in topological order of the condensation. The
+    // matrices are then block upper triangular and the blocks below the
+    // diagonal, which are unreachable, are never touched. Each component is
+    // closed on its own; then, from the last component back, its rows are
+    // extended to the later columns, which only later rows (already final)
+    // can reach. The numbering is undone at the end.
+    void GenerateComponents() {
+        const std::size_t n = vertices_.size();
+        std::vector<uint32_t> first_edge(n + 1, 0);
+        ForEachEdge([&](uint32_t from, uint32_t to, double) {
+            first_edge[from + 1] += from != to;
+        });
+        for (std::size_t v = 0; v < n; ++v) {
+            first_edge[v + 1] += first_edge[v];
+        }
+        std::vector<uint32_t> targets(first_edge[n]);
+        std::vector<uint32_t> fill(first_edge.begin(), first_edge.end() - 1);
+        ForEachEdge([&](uint32_t from, uint32_t to, double) {
+            if (from != to) {
+                targets[fill[from]++] = to;
+            }
+        });
+
+        const Condensation components = StrongComponents(first_edge, targets);
+        solve_order_ = components.vertices;
+        std::vector<uint32_t> new_id(n);
+        for (std::size_t v = 0; v < n; ++v) {
+            new_id[solve_order_[v]] = static_cast<uint32_t>(v);
+        }
+        for (uint32_t& target : targets) {
+            target = new_id[target];
+        }
+        PermuteMatrices(new_id);
+
+        CloseComponents(components);
+        std::vector<char> is_exit(n);
+        for (std::size_t c = components.size(); c-- > 0;) {
+            ExtendComponent(components.first_vertex[c], components.first_vertex[c + 1], first_edge, targets, is_exit);
+        }
+
+        PermuteMatrices(solve_order_);
+        solve_order_.clear();
+    }
+
+    // Components larger than a tile are closed one after the other by the
+    // blocked kernel, the rest concurrently by the naive one.
+    void CloseComponents(const Condensation& components) {
+        const std::size_t tile = options_.tile_size ? options_.tile_size : AutoTileSize();
+        std::vector<std::size_t> small;
+        for (std::size_t c = 0; c < components.size(); ++c) {
+            const std::size_t begin = components.first_vertex[c];
+            const std::size_t end = components.first_vertex[c + 1];
+            if (end - begin > tile) {
+                GenerateBlocked(tile, begin, end);
+            }
+            else if (end - begin > 1) {
+                small.push_back(c);
+            }
+        }
+
+        // Exceptions cannot leave a pool task, so a cycle is only noted there
+        // and reported afterwards.
+        const std::size_t n = vertices_.size();
+        std::vector<std::size_t> cycle_at(small.size(), n);
+        ParallelFor(small.size(), [&](std::size_t s) {
+            const std::size_t begin = components.first_vertex[small[s]];
+            const std::size_t end = components.first_vertex[small[s] + 1];
+            PivotLists pivot;
+            for (std::size_t k = begin; k < end; ++k) {
+                if (options_.negative_cycles == NegativeCyclePolicy::Fail && dist_matrix_[k * n + k] < 0) {
+                    cycle_at[s] = k;
+                    return;
+                }
+                CollectPivot(k, begin, end, pivot);
+                RelaxPivotRows(k, pivot, 0, pivot.rows.size(), begin, end);
+            }
+        });
+        for (std::size_t k : cycle_at) {
+            CheckNegativeCycle(k, std::min(k + 1, n));
+        }
+    }
+
+    // Extends the rows of the closed component [begin, end) to the columns
+    // [end, n). Every exit u, a vertex with edges leaving the component,
+    // first takes dist[u][v] + dist[v][*] for its targets v; every row i
+    // then takes dist[i][u] + dist[u][*] for every exit u. A shortest path
+    // leaves the component through one last exit, so one pass is exact.
+    // The exit rows are done first because the other rows read them.
+    void ExtendComponent(std::size_t begin, std::size_t end, const std::vector<uint32_t>& first_edge,
+                         const std::vector<uint32_t>& targets, std::vector<char>& is_exit) {
+        const std::size_t n = vertices_.size();
+        std::vector<uint32_t> exits;
+        for (std::size_t u = begin; u < end; ++u) {
+            const uint32_t original = solve_order_[u];
+            for (uint32_t e = first_edge[original]; e < first_edge[original + 1]; ++e) {
+                if (targets[e] >= end) {
+                    exits.push_back(static_cast<uint32_t>(u));
+                    is_exit[u] = true;
+                    break;
+                }
+            }
+        }
+        if (exits.empty()) {
+            return;
+        }
+
+        ParallelFor(exits.size(), [&](std::size_t x) {
+            const uint32_t u = exits[x];
+            const uint32_t original = solve_order_[u];
+            for (uint32_t e = first_edge[original]; e < first_edge[original + 1]; ++e) {
+                if (targets[e] >= end) {
+                    RelaxTile(u, u + 1, end, n, targets[e], targets[e] + 1);
+                }
+            }
+        });
+        for (uint32_t i : exits) {
+            for (uint32_t u : exits) {
+                if (u != i) {
+                    RelaxTile(i, i + 1, end, n, u, u + 1);
+                }
+            }
+        }
+        ParallelFor(end - begin, [&](std::size_t r) {
+            const std::size_t i = begin + r;
+            if (is_exit[i]) {
+                return;
+            }
+            for (uint32_t u : exits) {
+                RelaxTile(i, i + 1, end, n, u, u + 1);
+            }
+        });
+        for (uint32_t u : exits) {
+            is_exit[u] = false;
+        }
+    }
+
+    // Moves cell (i, j) of both matrices to (to[i], to[j]) and renames the
+    // successors to match, with O(V) scratch space.
+    void PermuteMatrices(const std::vector<uint32_t>& to) {
+        const std::size_t n = vertices_.size();
+        PermuteRows(dist_matrix_, to);
+        std::vector<Weight> dist_row(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            Weight* row = &dist_matrix_[i * n];
+            for (std::size_t j = 0; j < n; ++j) {
+                dist_row[to[j]] = row[j];
+            }
+            std::copy(dist_row.begin(), dist_row.end(), row);
+        }
+        if (!options_.track_paths) {
+            return;
+        }
+
+        PermuteRows(next_vertex_, to);
+        std::vector<int32_t> next_row(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            int32_t* row = &next_vertex_[i * n];
+            for (std::size_t j = 0; j < n; ++j) {
+                next_row[to[j]] = row[j] < 0 ? row[j] : static_cast<int32_t>(to[row[j]]);
+            }
+            std::copy(next_row.begin(), next_row.end(), row);
+        }
+    }
+
+    // Moves row i to row to[i], one cycle of the permutation at a time.
+    template<typename T>
+    void PermuteRows(std::vector<T>& matrix, const std::vector<uint32_t>& to) const {
+        const std::size_t n = vertices_.size();
+        std::vector<char> moved(n);
+        std::vector<T> carry(n);
+        for (std::size_t start = 0; start < n; ++start) {
+            if (moved[start]) {
+                continue;
+            }
+            std::copy(matrix.begin() + start * n, matrix.begin() + (start + 1) * n, carry.begin());
+            std::size_t current = start;
+            do {
+                current = to[current];
+                moved[current] = true;
+                std::swap_ranges(carry.begin(), carry.end(), matrix.begin() + current * n);
+            } while (current != start);
+        }
+    }
+
+    // Three-phase blocked Floyd-Warshall on the vertices [begin, end): for
+    // every pivot block b the diagonal tile is closed first, then the tiles
+    // sharing its row and column, then everything else. Tiles within phases
+    // two and three are independent and run in parallel.
+    void GenerateBlocked(std::size_t tile, std::size_t begin, std::size_t end) {
+        const std::size_t blocks = (end - begin + tile - 1) / tile;
+        for (std::size_t b = 0; b < blocks; ++b) {
+            const std::size_t b_begin = begin + b * tile;
+            const std::size_t b_end = std::min(b_begin + tile, end);
+            RelaxTile(b_begin, b_end, b_begin, b_end, b_begin, b_end);
+            CheckNegativeCycle(b_begin, b_end);
+
+            ParallelFor(2 * blocks, [&](std::size_t task) {
+                const std::size_t t = task / 2;
+                if (t == b) {
+                    return;
+                }
+                const std::size_t t_begin = begin + t * tile;
+                const std::size_t t_end = std::min(t_begin + tile, end);
+                if (task % 2 == 0) {
+                    RelaxTile(b_begin, b_end, t_begin, t_end, b_begin, b_end);
+                }
+                else {
+                    RelaxTile(t_begin, t_end, b_begin, b_end, b_begin, b_end);
+                }
+            });
+
+            ParallelFor(blocks * blocks, [&](std::size_t task) {
+                const std::size_t i = task / blocks;
+                const std::size_t j = task % blocks;
+                if (i == b || j == b) {
+                    return;
+                }
+                RelaxTile(begin + i * tile, std::min(begin + (i + 1) * tile, end), begin + j * tile,
+                          std::min(begin + (j + 1) * tile, end), b_begin, b_end);
+            });
+        }
+    }
+
+    // Largest multiple of 8 such that three tiles of distances (and
+    // successors, when tracked) fit into L2 together.
+    std::size_t AutoTileSize() const {
+        std::size_t l2 = 256 * 1024;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+        const long detected = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (detected > 0) {
+            l2 = static_cast<std::size_t>(detected);
+        }
+#endif
+        const std::size_t bytes_per_cell = 3 * (sizeof(Weight) + (options_.track_paths ? sizeof(int32_t) : 0));
+        const std::size_t tile = static_cast<std::size_t>(std::sqrt(static_cast<double>(l2 / bytes_per_cell)));
+        return std::max<std::size_t>(16, tile / 8 * 8);
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "instrumentation.h"
+
+// Output stage for the result files: text is collected in one large buffer
+// and handed to the OS in buffer-sized chunks, numbers are formatted with
+// std::to_chars. WriteNumber produces the same text as the default
+// std::ostream formatting of a double ("%g" with precision 6).
+class DistanceWriter {
+public:
+    static constexpr std::size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    explicit DistanceWriter(const std::string& file_name, std::size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        : file_(std::fopen(file_name.c_str(), "wb")), buffer_(new char[buffer_size]), capacity_(buffer_size) {
+        if (!file_) {
+            throw std::runtime_error("Cannot open " + file_name + " for writing");
+        }
+        std::setvbuf(file_, nullptr, _IONBF, 0);
+    }
+
+    DistanceWriter(const DistanceWriter&) = delete;
+    DistanceWriter& operator=(const DistanceWriter&) = delete;
+
+    ~DistanceWriter() {
+        if (file_) {
+            try {
+                Flush();
+            }
+            catch (const std::exception&) {
+            }
+            std::fclose(file_);
+        }
+    }
+
+    void Write(std::string_view text) {
+        if (text.size() > capacity_ - size_) {
+            Flush();
+            if (text.size() > capacity_) {
+                WriteChunk(text.data(), text.size());
+                return;
+            }
+        }
+        std::memcpy(buffer_.get() + size_, text.data(), text.size());
+        size_ += text.size();
+    }
+
+    void Write(char c) {
+        if (size_ == capacity_) {
+            Flush();
+        }
+        buffer_[size_++] = c;
+    }
+
+    void WriteNumber(double value) {
+        char digits[32];
+        Write(FormatNumber(value, digits));
+    }
+
+    static std::string_view FormatNumber(double value, char (&digits)[32]) {
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+        return { digits, static_cast<std::size_t>(result.ptr - digits) };
+    }
+
+    void Flush() {
+        WriteChunk(buffer_.get(), size_);
+        size_ = 0;
+    }
+
+    void Close() {
+        Flush();
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    std::size_t BytesWritten() const {
+        return written_ + size_;
+    }
+
+private:
+    std::FILE* file_;
+    std::unique_ptr<char[]> buffer_;
+    std::size_t capacity_;
+    std::size_t size_ = 0;
+    std::size_t written_ = 0;
+
+    void WriteChunk(const char* data, std::size_t size) {
+        if (size && std::fwrite(data, 1, size, file_) != size) {
+            throw std::runtime_error("Failed to write the result file");
+        }
+        written_ += size;
+        FW_COUNT(Counter::BytesWritten, size);
+    }
+};
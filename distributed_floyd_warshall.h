@@ -0,0 +1,725 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dense_floyd_warshall.h"
+#include "distance_writer.h"
+#include "edge_list.h"
+#include "instrumentation.h"
+#include "relax_kernels.h"
+#include "result_matrix.h"
+#include "thread_pool.h"
+#include "vertex_dictionary.h"
+#include "weight_traits.h"
+
+template<typename Weight>
+MPI_Datatype MpiTypeOf() {
+    if constexpr (std::is_same_v<Weight, int32_t>) {
+        return MPI_INT32_T;
+    }
+    else if constexpr (std::is_same_v<Weight, float>) {
+        return MPI_FLOAT;
+    }
+    else {
+        static_assert(std::is_same_v<Weight, double>, "unsupported weight type");
+        return MPI_DOUBLE;
+    }
+}
+
+// NarrowestWeightType over the edges of every rank, each holding one slice
+// of the edge list as returned by ReadBinaryEdgeList(file, rank, ranks).
+inline WeightType NarrowestWeightType(const EdgeList& part, MPI_Comm comm) {
+    const std::span<const Edge> edges = part.Edges();
+    int finite = 1;
+    double max_abs = 0;
+    for (const Edge& edge : edges) {
+        if (!std::isfinite(edge.weight)) {
+            finite = 0;
+            break;
+        }
+        max_abs = std::max(max_abs, std::abs(edge.weight));
+    }
+    // The smallest exponent that scales every weight to an integer; whether
+    // a weight stays integral only improves as the exponent grows.
+    int exponent = 0;
+    while (finite && exponent < std::numeric_limits<float>::digits
+           && !std::all_of(edges.begin(), edges.end(), [exponent](const Edge& edge) {
+                  const double scaled = std::ldexp(edge.weight, exponent);
+                  return scaled == std::trunc(scaled);
+              })) {
+        ++exponent;
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &finite, 1, MPI_INT, MPI_MIN, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &max_abs, 1, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &exponent, 1, MPI_INT, MPI_MAX, comm);
+    if (!finite) {
+        return WeightType::Double;
+    }
+    const double path_bound = max_abs * static_cast<double>(std::max<std::size_t>(part.vertices.size(), 2) - 1);
+    if (path_bound < std::numeric_limits<int32_t>::max() && exponent == 0) {
+        return WeightType::Int32;
+    }
+    if (exponent < std::numeric_limits<float>::digits
+        && std::ldexp(path_bound, exponent) <= std::ldexp(1.0, std::numeric_limits<float>::digits)) {
+        return WeightType::Float;
+    }
+    return WeightType::Double;
+}
+
+// Blocked Floyd-Warshall across the ranks of an MPI communicator. The ranks
+// form an R x C grid and the matrix is cut into B x B tiles dealt out 2D
+// block-cyclically: tile (I, J) lives on rank (I mod R, J mod C), which
+// keeps its tiles as one row-major local matrix. For every pivot block k
+// the owner of tile (k, k) closes it and sends it along its grid row and
+// column, those ranks relax the rest of tile row and column k, and the
+// finished row and column panels are broadcast down the grid columns and
+// along the grid rows so that every rank relaxes its remaining tiles with
+// the same row kernel as DenseKernel::Blocked. All ranks end with the same
+// result as the tiled engine at tile size B.
+//
+// The graph is loaded in parts as well: each rank reads one slice of a
+// binary edge list and sends every edge to the rank owning its cell, so no
+// rank holds more than its own tiles' edges. The result is written in the
+// format of result_matrix.h with collective MPI-IO, each rank writing its
+// own tiles.
+//
+// Every member function is collective and must be called on all ranks;
+// exceptions are raised on all ranks alike. Uses the tile_size (0 picks
+// DEFAULT_TILE), simd, threads (per rank), track_paths and negative_cycles
+// fields of DenseOptions.
+template<typename Weight = double>
+class DistributedFloydWarshall {
+public:
+    using Traits = WeightTraits<Weight>;
+
+    static constexpr std::size_t DEFAULT_TILE = 256;
+
+    DistributedFloydWarshall(MPI_Comm comm, EdgeList part, const DenseOptions& options = {})
+        : comm_(comm), options_(options), relax_row_(SelectRelaxRow<Weight>(options.simd, options.track_paths)) {
+        int size = 0;
+        MPI_Comm_rank(comm_, &rank_);
+        MPI_Comm_size(comm_, &size);
+        int dims[2] = { 0, 0 };
+        MPI_Dims_create(size, 2, dims);
+        grid_rows_ = static_cast<std::size_t>(dims[0]);
+        grid_cols_ = static_cast<std::size_t>(dims[1]);
+        // Row-major rank order, as MPI_Type_create_darray expects.
+        grid_row_ = static_cast<std::size_t>(rank_) / grid_cols_;
+        grid_col_ = static_cast<std::size_t>(rank_) % grid_cols_;
+        MPI_Comm_split(comm_, static_cast<int>(grid_row_), static_cast<int>(grid_col_), &row_comm_);
+        MPI_Comm_split(comm_, static_cast<int>(grid_col_), static_cast<int>(grid_row_), &col_comm_);
+
+        vertices_ = std::move(part.vertices);
+        tile_ = options_.tile_size ? options_.tile_size : DEFAULT_TILE;
+        blocks_ = (vertices_.size() + tile_ - 1) / tile_;
+        local_rows_ = LocalBlocks(grid_row_, grid_rows_) * tile_;
+        local_cols_ = LocalBlocks(grid_col_, grid_cols_) * tile_;
+        DistributeEdges(part);
+        InitDistanceMatrix();
+    }
+
+    DistributedFloydWarshall(const DistributedFloydWarshall&) = delete;
+    DistributedFloydWarshall& operator=(const DistributedFloydWarshall&) = delete;
+
+    ~DistributedFloydWarshall() {
+        MPI_Comm_free(&row_comm_);
+        MPI_Comm_free(&col_comm_);
+    }
+
+    void GenerateDistanceMatrix() {
+        FW_PHASE(Phase::GenerateDistanceMatrix);
+        if (options_.threads != 1 && !pool_) {
+            pool_ = std::make_unique<ThreadPool>(options_.threads);
+        }
+
+        GenerateBlocked();
+        MarkUnboundedPairs();
+        // As in DenseFloydWarshall, out-of-order pivots can close successor
+        // loops on zero-weight cycles; the repair runs the pivots in order.
+        if (options_.track_paths && !SuccessorsAreAcyclic()) {
+            InitDistanceMatrix();
+            GenerateNaive();
+            MarkUnboundedPairs();
+        }
+    }
+
+    const VertexDictionary& Vertices() const {
+        return vertices_;
+    }
+
+    // Writes output/<file_name> in the binary result format. Rank 0 writes
+    // the header and name table, then every rank writes its own tiles.
+    void SaveResultMatrix(const std::string& file_name) const {
+        FW_PHASE(Phase::PrintDistances);
+        const std::string path = "output/" + file_name;
+        const ResultMatrixHeader header = MakeResultMatrixHeader<Weight>(vertices_, options_.track_paths);
+        int prefix_written = 1;
+        if (rank_ == 0) {
+            try {
+                DistanceWriter file_out(path);
+                WriteResultMatrixPrefix(file_out, header, vertices_);
+                file_out.Close();
+            }
+            catch (const std::exception&) {
+                prefix_written = 0;
+            }
+        }
+        MPI_Bcast(&prefix_written, 1, MPI_INT, 0, comm_);
+        if (!prefix_written) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+
+        MPI_File file;
+        if (MPI_File_open(comm_, path.c_str(), MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        int status = WriteMatrix(file, header.dist_offset, dist_.data(), MpiTypeOf<Weight>());
+        if (status == MPI_SUCCESS && options_.track_paths) {
+            status = WriteMatrix(file, header.next_offset, next_.data(), MPI_INT32_T);
+        }
+        MPI_File_close(&file);
+        if (status != MPI_SUCCESS) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+
+private:
+    MPI_Comm comm_;
+    MPI_Comm row_comm_ = MPI_COMM_NULL;
+    MPI_Comm col_comm_ = MPI_COMM_NULL;
+    int rank_ = 0;
+    std::size_t grid_rows_ = 1;
+    std::size_t grid_cols_ = 1;
+    std::size_t grid_row_ = 0;
+    std::size_t grid_col_ = 0;
+    DenseOptions options_;
+    RelaxRowFn<Weight> relax_row_;
+    std::unique_ptr<ThreadPool> pool_;
+    VertexDictionary vertices_;
+    // The edges of this rank's tiles, in file order, for rebuilding.
+    std::vector<Edge> edges_;
+    std::size_t tile_ = 0;
+    std::size_t blocks_ = 0;
+    // Local matrix size, padded to whole tiles; padding stays unreachable.
+    std::size_t local_rows_ = 0;
+    std::size_t local_cols_ = 0;
+    std::vector<Weight> dist_;
+    std::vector<int32_t> next_;
+    // Receive buffers for the pivot tile and the pivot row and column panels.
+    std::vector<Weight> pivot_;
+    std::vector<int32_t> pivot_next_;
+    std::vector<Weight> row_panel_;
+    std::vector<Weight> col_panel_;
+    std::vector<int32_t> col_panel_next_;
+
+    // Tiles of one grid dimension owned by grid position `position`.
+    std::size_t LocalBlocks(std::size_t position, std::size_t grid) const {
+        return blocks_ > position ? (blocks_ - position + grid - 1) / grid : 0;
+    }
+
+    int OwnerRank(std::size_t block_row, std::size_t block_col) const {
+        return static_cast<int>(block_row % grid_rows_ * grid_cols_ + block_col % grid_cols_);
+    }
+
+    bool OwnsCell(std::size_t i, std::size_t j) const {
+        return i / tile_ % grid_rows_ == grid_row_ && j / tile_ % grid_cols_ == grid_col_;
+    }
+
+    std::size_t LocalRow(std::size_t i) const {
+        return i / tile_ / grid_rows_ * tile_ + i % tile_;
+    }
+
+    std::size_t LocalCol(std::size_t j) const {
+        return j / tile_ / grid_cols_ * tile_ + j % tile_;
+    }
+
+    std::size_t GlobalRow(std::size_t r) const {
+        return (r / tile_ * grid_rows_ + grid_row_) * tile_ + r % tile_;
+    }
+
+    std::size_t GlobalCol(std::size_t c) const {
+        return (c / tile_ * grid_cols_ + grid_col_) * tile_ + c % tile_;
+    }
+
+    // First cell of local tile (p, q), in local tile coordinates.
+    std::size_t TileOffset(std::size_t p, std::size_t q) const {
+        return p * tile_ * local_cols_ + q * tile_;
+    }
+
+    void DistributeEdges(const EdgeList& part) {
+        FW_PHASE(Phase::InitEdges);
+        int size = 0;
+        MPI_Comm_size(comm_, &size);
+        const std::span<const Edge> edges = part.Edges();
+        FW_COUNT(Counter::BytesRead, edges.size_bytes());
+
+        std::vector<int> send_counts(size, 0);
+        for (const Edge& edge : edges) {
+            ++send_counts[OwnerRank(edge.from / tile_, edge.to / tile_)];
+        }
+        std::vector<int> recv_counts(size, 0);
+        MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm_);
+
+        std::vector<int> send_offsets(size, 0);
+        std::vector<int> recv_offsets(size, 0);
+        for (int r = 1; r < size; ++r) {
+            send_offsets[r] = send_offsets[r - 1] + send_counts[r - 1];
+            recv_offsets[r] = recv_offsets[r - 1] + recv_counts[r - 1];
+        }
+        std::vector<Edge> send(edges.size());
+        std::vector<int> cursor = send_offsets;
+        for (const Edge& edge : edges) {
+            send[cursor[OwnerRank(edge.from / tile_, edge.to / tile_)]++] = edge;
+        }
+        edges_.resize(static_cast<std::size_t>(recv_offsets[size - 1]) + recv_counts[size - 1]);
+
+        // Slices arrive in rank order, so the file order of duplicate edges
+        // is kept and the last one wins as in the other engines.
+        MPI_Datatype edge_type;
+        MPI_Type_contiguous(sizeof(Edge), MPI_BYTE, &edge_type);
+        MPI_Type_commit(&edge_type);
+        MPI_Alltoallv(send.data(), send_counts.data(), send_offsets.data(), edge_type, edges_.data(),
+                      recv_counts.data(), recv_offsets.data(), edge_type, comm_);
+        MPI_Type_free(&edge_type);
+    }
+
+    void InitDistanceMatrix() {
+        FW_PHASE(Phase::InitDistanceMatrix);
+        dist_.assign(local_rows_ * local_cols_, Traits::Infinity());
+        if (options_.track_paths) {
+            next_.assign(local_rows_ * local_cols_, -1);
+        }
+        for (const Edge& edge : edges_) {
+            const std::size_t cell = LocalRow(edge.from) * local_cols_ + LocalCol(edge.to);
+            dist_[cell] = static_cast<Weight>(edge.weight);
+            if (options_.track_paths) {
+                next_[cell] = static_cast<int32_t>(edge.to);
+            }
+        }
+        for (std::size_t v = 0; v < vertices_.size(); ++v) {
+            if (OwnsCell(v, v)) {
+                dist_[LocalRow(v) * local_cols_ + LocalCol(v)] = 0;
+            }
+        }
+    }
+
+    // Relaxes one tile through its block's tile_ pivots:
+    //     dist[r][c] = min(dist[r][c], col[r][k] + row[k][c])
+    // with first hops taken from col_next. Each matrix is given by its first
+    // cell and row stride; dist may alias col or row.
+    void RelaxTile(Weight* dist, int32_t* next, std::size_t stride, const Weight* col, const int32_t* col_next,
+                   std::size_t col_stride, const Weight* row, std::size_t row_stride) const {
+        for (std::size_t k = 0; k < tile_; ++k) {
+            const Weight* row_k = row + k * row_stride;
+            for (std::size_t r = 0; r < tile_; ++r) {
+                const Weight i_k = col[r * col_stride + k];
+                if (i_k == Traits::Infinity()) {
+                    continue;
+                }
+                FW_COUNT(Counter::Relaxations, tile_);
+                relax_row_(dist + r * stride, next ? next + r * stride : nullptr, row_k, i_k,
+                           col_next ? col_next[r * col_stride + k] : -1, 0, tile_);
+            }
+        }
+    }
+
+    int32_t* NextAt(std::size_t offset) {
+        return options_.track_paths ? next_.data() + offset : nullptr;
+    }
+
+    void GenerateBlocked() {
+        const std::size_t tile_cells = tile_ * tile_;
+        const std::size_t block_rows = local_rows_ / tile_;
+        const std::size_t block_cols = local_cols_ / tile_;
+        pivot_.resize(tile_cells);
+        pivot_next_.resize(options_.track_paths ? tile_cells : 0);
+        row_panel_.resize(tile_ * local_cols_);
+        col_panel_.resize(local_rows_ * tile_);
+        col_panel_next_.resize(options_.track_paths ? local_rows_ * tile_ : 0);
+
+        for (std::size_t b = 0; b < blocks_; ++b) {
+            const bool pivot_row = b % grid_rows_ == grid_row_;
+            const bool pivot_col = b % grid_cols_ == grid_col_;
+            const std::size_t p_b = b / grid_rows_;
+            const std::size_t q_b = b / grid_cols_;
+
+            if (pivot_row && pivot_col) {
+                const std::size_t offset = TileOffset(p_b, q_b);
+                Weight* diagonal = dist_.data() + offset;
+                RelaxTile(diagonal, NextAt(offset), local_cols_, diagonal, NextAt(offset), local_cols_, diagonal,
+                          local_cols_);
+                CopyTile(diagonal, local_cols_, pivot_.data(), tile_);
+                if (options_.track_paths) {
+                    CopyTile(NextAt(offset), local_cols_, pivot_next_.data(), tile_);
+                }
+            }
+            CheckNegativeCycle(b);
+
+            if (pivot_row) {
+                Broadcast(pivot_, pivot_next_, row_comm_, b % grid_cols_);
+            }
+            if (pivot_col) {
+                Broadcast(pivot_, pivot_next_, col_comm_, b % grid_rows_);
+            }
+            const std::size_t row_tasks = pivot_row ? block_cols : 0;
+            const std::size_t col_tasks = pivot_col ? block_rows : 0;
+            ParallelFor(row_tasks + col_tasks, [&](std::size_t task) {
+                if (task < row_tasks) {
+                    if (pivot_col && task == q_b) {
+                        return;
+                    }
+                    const std::size_t offset = TileOffset(p_b, task);
+                    RelaxTile(dist_.data() + offset, NextAt(offset), local_cols_, pivot_.data(),
+                              options_.track_paths ? pivot_next_.data() : nullptr, tile_, dist_.data() + offset,
+                              local_cols_);
+                }
+                else {
+                    const std::size_t p = task - row_tasks;
+                    if (pivot_row && p == p_b) {
+                        return;
+                    }
+                    const std::size_t offset = TileOffset(p, q_b);
+                    RelaxTile(dist_.data() + offset, NextAt(offset), local_cols_, dist_.data() + offset,
+                              NextAt(offset), local_cols_, pivot_.data(), tile_);
+                }
+            });
+
+            const Weight* row_panel = BroadcastRowPanel(b);
+            BroadcastColumnPanel(b, options_.track_paths);
+            ParallelFor(block_rows * block_cols, [&](std::size_t task) {
+                const std::size_t p = task / block_cols;
+                const std::size_t q = task % block_cols;
+                if ((pivot_row && p == p_b) || (pivot_col && q == q_b)) {
+                    return;
+                }
+                const std::size_t offset = TileOffset(p, q);
+                RelaxTile(dist_.data() + offset, NextAt(offset), local_cols_, col_panel_.data() + p * tile_cells,
+                          options_.track_paths ? col_panel_next_.data() + p * tile_cells : nullptr, tile_,
+                          row_panel + q * tile_, local_cols_);
+            });
+        }
+    }
+
+    // Pivot by pivot over the whole matrix, as DenseKernel::Naive: row k is
+    // sent down the grid columns and column k along the grid rows.
+    void GenerateNaive() {
+        const std::size_t n = vertices_.size();
+        row_panel_.resize(local_cols_);
+        col_panel_.resize(local_rows_);
+        col_panel_next_.resize(options_.track_paths ? local_rows_ : 0);
+        const std::size_t chunks = std::min(local_rows_, pool_ ? pool_->size() * 4 : 1);
+        const std::size_t rows_per_chunk = chunks ? (local_rows_ + chunks - 1) / chunks : 0;
+        for (std::size_t k = 0; k < n; ++k) {
+            const bool pivot_row = k / tile_ % grid_rows_ == grid_row_;
+            const bool pivot_col = k / tile_ % grid_cols_ == grid_col_;
+            const Weight* row_k = row_panel_.data();
+            if (pivot_row) {
+                row_k = dist_.data() + LocalRow(k) * local_cols_;
+            }
+            MPI_Bcast(const_cast<Weight*>(row_k), static_cast<int>(local_cols_), MpiTypeOf<Weight>(),
+                      static_cast<int>(k / tile_ % grid_rows_), col_comm_);
+            if (pivot_col) {
+                for (std::size_t r = 0; r < local_rows_; ++r) {
+                    col_panel_[r] = dist_[r * local_cols_ + LocalCol(k)];
+                    if (options_.track_paths) {
+                        col_panel_next_[r] = next_[r * local_cols_ + LocalCol(k)];
+                    }
+                }
+            }
+            Broadcast(col_panel_, col_panel_next_, row_comm_, k / tile_ % grid_cols_);
+
+            ParallelFor(chunks, [&](std::size_t chunk) {
+                const std::size_t r_end = std::min((chunk + 1) * rows_per_chunk, local_rows_);
+                for (std::size_t r = chunk * rows_per_chunk; r < r_end; ++r) {
+                    const Weight i_k = col_panel_[r];
+                    if (i_k == Traits::Infinity()) {
+                        continue;
+                    }
+                    FW_COUNT(Counter::Relaxations, local_cols_);
+                    relax_row_(dist_.data() + r * local_cols_, NextAt(r * local_cols_), row_k, i_k,
+                               options_.track_paths ? col_panel_next_[r] : -1, 0, local_cols_);
+                }
+            });
+        }
+    }
+
+    static void CopyTile(const auto* from, std::size_t from_stride, auto* to, std::size_t tile) {
+        for (std::size_t r = 0; r < tile; ++r) {
+            std::copy_n(from + r * from_stride, tile, to + r * tile);
+        }
+    }
+
+    void Broadcast(std::vector<Weight>& dist, std::vector<int32_t>& next, MPI_Comm comm, std::size_t root) const {
+        MPI_Bcast(dist.data(), static_cast<int>(dist.size()), MpiTypeOf<Weight>(), static_cast<int>(root), comm);
+        if (!next.empty()) {
+            MPI_Bcast(next.data(), static_cast<int>(next.size()), MPI_INT32_T, static_cast<int>(root), comm);
+        }
+    }
+
+    // Tile row b of the grid column holding it, sent down that column. The
+    // owning rank sends straight from its matrix, where the row is one
+    // contiguous run of tile_ local rows.
+    const Weight* BroadcastRowPanel(std::size_t b) {
+        const Weight* panel = row_panel_.data();
+        if (b % grid_rows_ == grid_row_) {
+            panel = dist_.data() + b / grid_rows_ * tile_ * local_cols_;
+        }
+        MPI_Bcast(const_cast<Weight*>(panel), static_cast<int>(tile_ * local_cols_), MpiTypeOf<Weight>(),
+                  static_cast<int>(b % grid_rows_), col_comm_);
+        return panel;
+    }
+
+    // Tile column b of the grid row holding it, packed tile by tile into
+    // col_panel_ and sent along that row.
+    void BroadcastColumnPanel(std::size_t b, bool with_next) {
+        const std::size_t tile_cells = tile_ * tile_;
+        if (b % grid_cols_ == grid_col_) {
+            const std::size_t q_b = b / grid_cols_;
+            for (std::size_t p = 0; p < local_rows_ / tile_; ++p) {
+                CopyTile(dist_.data() + TileOffset(p, q_b), local_cols_, col_panel_.data() + p * tile_cells, tile_);
+                if (with_next) {
+                    CopyTile(NextAt(TileOffset(p, q_b)), local_cols_, col_panel_next_.data() + p * tile_cells,
+                             tile_);
+                }
+            }
+        }
+        std::vector<int32_t> no_next;
+        Broadcast(col_panel_, with_next ? col_panel_next_ : no_next, row_comm_, b % grid_cols_);
+    }
+
+    template<typename Func>
+    void ParallelFor(std::size_t count, Func&& func) {
+        if (pool_) {
+            pool_->ParallelFor(count, func);
+        }
+        else {
+            for (std::size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+        }
+    }
+
+    // Once tile (b, b) is closed a negative cycle through one of its
+    // vertices shows on its diagonal; the owner sends those vertices to
+    // every rank so that all of them throw.
+    void CheckNegativeCycle(std::size_t b) const {
+        if (options_.negative_cycles != NegativeCyclePolicy::Fail) {
+            return;
+        }
+
+        const int owner = OwnerRank(b, b);
+        std::vector<int32_t> on_cycle;
+        if (rank_ == owner) {
+            for (std::size_t v = b * tile_; v < std::min(vertices_.size(), (b + 1) * tile_); ++v) {
+                if (dist_[LocalRow(v) * local_cols_ + LocalCol(v)] < 0) {
+                    on_cycle.push_back(static_cast<int32_t>(v));
+                }
+            }
+        }
+        int count = static_cast<int>(on_cycle.size());
+        MPI_Bcast(&count, 1, MPI_INT, owner, comm_);
+        if (count == 0) {
+            return;
+        }
+        on_cycle.resize(count);
+        MPI_Bcast(on_cycle.data(), count, MPI_INT32_T, owner, comm_);
+
+        std::vector<std::string> names;
+        for (int32_t v : on_cycle) {
+            names.emplace_back(vertices_.Name(static_cast<std::size_t>(v)));
+        }
+        throw NegativeCycleException(std::move(names));
+    }
+
+    // Same marking as DenseFloydWarshall::MarkUnboundedPairs: (i, j) is
+    // unbounded if i reaches a vertex c with dist[c][c] < 0 that reaches j.
+    // The panels of every tile row and column holding such a c are
+    // broadcast as in GenerateBlocked; marking only turns finite distances
+    // into -INF, so reachability is unchanged while it runs.
+    void MarkUnboundedPairs() {
+        int size = 0;
+        MPI_Comm_size(comm_, &size);
+        std::vector<int32_t> local;
+        for (std::size_t v = 0; v < vertices_.size(); ++v) {
+            if (OwnsCell(v, v) && dist_[LocalRow(v) * local_cols_ + LocalCol(v)] < 0) {
+                local.push_back(static_cast<int32_t>(v));
+            }
+        }
+        std::vector<int> counts(size);
+        const int count = static_cast<int>(local.size());
+        MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm_);
+        std::vector<int> offsets(size, 0);
+        for (int r = 1; r < size; ++r) {
+            offsets[r] = offsets[r - 1] + counts[r - 1];
+        }
+        std::vector<int32_t> on_cycle(static_cast<std::size_t>(offsets[size - 1]) + counts[size - 1]);
+        if (on_cycle.empty()) {
+            return;
+        }
+        MPI_Allgatherv(local.data(), count, MPI_INT32_T, on_cycle.data(), counts.data(), offsets.data(), MPI_INT32_T,
+                       comm_);
+        std::sort(on_cycle.begin(), on_cycle.end());
+
+        row_panel_.resize(tile_ * local_cols_);
+        col_panel_.resize(local_rows_ * tile_);
+        const std::size_t tile_cells = tile_ * tile_;
+        for (auto first = on_cycle.begin(); first != on_cycle.end();) {
+            const std::size_t b = static_cast<std::size_t>(*first) / tile_;
+            const auto last = std::find_if(first, on_cycle.end(), [&](int32_t v) {
+                return static_cast<std::size_t>(v) / tile_ != b;
+            });
+            const Weight* row_panel = BroadcastRowPanel(b);
+            BroadcastColumnPanel(b, false);
+
+            ParallelFor(local_rows_, [&](std::size_t r) {
+                const Weight* col = col_panel_.data() + r / tile_ * tile_cells + r % tile_ * tile_;
+                Weight* dist = dist_.data() + r * local_cols_;
+                for (auto c = first; c != last; ++c) {
+                    const std::size_t k = static_cast<std::size_t>(*c) % tile_;
+                    if (col[k] == Traits::Infinity()) {
+                        continue;
+                    }
+                    for (std::size_t j = 0; j < local_cols_; ++j) {
+                        if (row_panel[k * local_cols_ + j] != Traits::Infinity()) {
+                            dist[j] = Traits::NegativeInfinity();
+                        }
+                    }
+                }
+            });
+            first = last;
+        }
+    }
+
+    // The walk of DenseFloydWarshall::RepairSuccessors, as a check. Every walk
+    // towards j stays in j's tile column, so each tile column is gathered
+    // on one rank of its grid column, which checks it.
+    bool SuccessorsAreAcyclic() const {
+        const std::size_t n = vertices_.size();
+        const std::size_t tile_cells = tile_ * tile_;
+        const std::size_t block_rows = local_rows_ / tile_;
+        std::vector<int> counts(grid_rows_);
+        std::vector<int> offsets(grid_rows_, 0);
+        for (std::size_t p = 0; p < grid_rows_; ++p) {
+            counts[p] = static_cast<int>(LocalBlocks(p, grid_rows_) * tile_cells);
+            offsets[p] = p ? offsets[p - 1] + counts[p - 1] : 0;
+        }
+
+        int acyclic = 1;
+        std::vector<Weight> send_dist(block_rows * tile_cells);
+        std::vector<int32_t> send_next(block_rows * tile_cells);
+        std::vector<Weight> column_dist;
+        std::vector<int32_t> column_next;
+        std::vector<std::size_t> walk_of;
+        for (std::size_t q = 0; q < local_cols_ / tile_; ++q) {
+            const int root = static_cast<int>(q % grid_rows_);
+            for (std::size_t p = 0; p < block_rows; ++p) {
+                CopyTile(dist_.data() + TileOffset(p, q), local_cols_, send_dist.data() + p * tile_cells, tile_);
+                CopyTile(next_.data() + TileOffset(p, q), local_cols_, send_next.data() + p * tile_cells, tile_);
+            }
+            const bool is_root = grid_row_ == static_cast<std::size_t>(root);
+            column_dist.resize(is_root ? blocks_ * tile_cells : 0);
+            column_next.resize(is_root ? blocks_ * tile_cells : 0);
+            MPI_Gatherv(send_dist.data(), static_cast<int>(send_dist.size()), MpiTypeOf<Weight>(), column_dist.data(),
+                        counts.data(), offsets.data(), MpiTypeOf<Weight>(), root, col_comm_);
+            MPI_Gatherv(send_next.data(), static_cast<int>(send_next.size()), MPI_INT32_T, column_next.data(),
+                        counts.data(), offsets.data(), MPI_INT32_T, root, col_comm_);
+            if (!is_root || !acyclic) {
+                continue;
+            }
+
+            // Gathered tiles come grouped by grid row; cell (i, c) of the
+            // column is tile i / tile_ of grid row (i / tile_) % R.
+            auto cell = [&](std::size_t i, std::size_t c) {
+                const std::size_t block = i / tile_;
+                return static_cast<std::size_t>(offsets[block % grid_rows_]) + block / grid_rows_ * tile_cells
+                    + i % tile_ * tile_ + c;
+            };
+            const std::size_t j_begin = (q * grid_cols_ + grid_col_) * tile_;
+            walk_of.assign(n, std::numeric_limits<std::size_t>::max());
+            for (std::size_t c = 0; c < tile_ && j_begin + c < n && acyclic; ++c) {
+                const std::size_t j = j_begin + c;
+                const std::size_t first_walk = c * n;
+                for (std::size_t i = 0; i < n && acyclic; ++i) {
+                    const std::size_t walk = first_walk + i;
+                    std::size_t current = i;
+                    while (current != j && column_dist[cell(current, c)] != Traits::Infinity()
+                           && column_dist[cell(current, c)] != Traits::NegativeInfinity()) {
+                        if (walk_of[current] == walk) {
+                            acyclic = 0;
+                            break;
+                        }
+                        if (walk_of[current] != std::numeric_limits<std::size_t>::max()
+                            && walk_of[current] >= first_walk) {
+                            break;
+                        }
+                        walk_of[current] = walk;
+                        current = static_cast<std::size_t>(column_next[cell(current, c)]);
+                    }
+                }
+            }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &acyclic, 1, MPI_INT, MPI_MIN, comm_);
+        return acyclic != 0;
+    }
+
+    // Collective write of a local matrix into its place in the row-major
+    // V x V matrix at `offset`: the file view is the block-cyclic
+    // distribution itself and the memory type skips the tile padding.
+    template<typename Cell>
+    int WriteMatrix(MPI_File file, uint64_t offset, const Cell* data, MPI_Datatype type) const {
+        const std::size_t n = vertices_.size();
+        if (n == 0) {
+            return MPI_SUCCESS;
+        }
+        int size = 0;
+        MPI_Comm_size(comm_, &size);
+        const int global[2] = { static_cast<int>(n), static_cast<int>(n) };
+        const int distribs[2] = { MPI_DISTRIBUTE_CYCLIC, MPI_DISTRIBUTE_CYCLIC };
+        const int dargs[2] = { static_cast<int>(tile_), static_cast<int>(tile_) };
+        const int grid[2] = { static_cast<int>(grid_rows_), static_cast<int>(grid_cols_) };
+        MPI_Datatype file_type;
+        MPI_Type_create_darray(size, rank_, 2, global, distribs, dargs, grid, MPI_ORDER_C, type, &file_type);
+        MPI_Type_commit(&file_type);
+
+        std::size_t rows = 0;
+        std::size_t cols = 0;
+        for (std::size_t r = 0; r < local_rows_; ++r) {
+            rows += GlobalRow(r) < n;
+        }
+        for (std::size_t c = 0; c < local_cols_; ++c) {
+            cols += GlobalCol(c) < n;
+        }
+        int status = MPI_File_set_view(file, static_cast<MPI_Offset>(offset), type, file_type, "native", MPI_INFO_NULL);
+        if (rows && cols) {
+            const int sizes[2] = { static_cast<int>(local_rows_), static_cast<int>(local_cols_) };
+            const int subsizes[2] = { static_cast<int>(rows), static_cast<int>(cols) };
+            const int starts[2] = { 0, 0 };
+            MPI_Datatype memory_type;
+            MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, type, &memory_type);
+            MPI_Type_commit(&memory_type);
+            const int written = MPI_File_write_all(file, data, 1, memory_type, MPI_STATUS_IGNORE);
+            status = status == MPI_SUCCESS ? written : status;
+            MPI_Type_free(&memory_type);
+        }
+        else {
+            const int written = MPI_File_write_all(file, data, 0, type, MPI_STATUS_IGNORE);
+            status = status == MPI_SUCCESS ? written : status;
+        }
+        MPI_Type_free(&file_type);
+        return status;
+    }
+};
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "distance_writer.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "vertex_dictionary.h"
+
+struct Edge {
+    uint32_t from;
+    uint32_t to;
+    double weight;
+};
+
+// A loaded graph: vertex ids are assigned in order of first appearance.
+// Edges either live in `edges` or, for a mapped binary graph, directly in
+// the mapping that `mapping` keeps alive; Edges() covers both.
+struct EdgeList {
+    VertexDictionary vertices;
+    std::vector<Edge> edges;
+    std::shared_ptr<const MappedFile> mapping;
+    std::span<const Edge> mapped_edges;
+
+    std::span<const Edge> Edges() const {
+        return mapping ? mapped_edges : std::span<const Edge>(edges);
+    }
+};
+
+// Binary edge list, little-endian:
+//     BinaryGraphHeader
+//     uint64_t name_end[vertex_count]   end offset of each name in the name block
+//     char     names[name_bytes]        names of vertices 0..V-1, concatenated
+//     padding to 8 bytes
+//     Edge     edges[edge_count]        (u32 from, u32 to, f64 weight) records
+struct BinaryGraphHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t weight_type;
+    uint64_t edge_count;
+    uint64_t name_bytes;
+    uint64_t edges_offset;
+};
+
+constexpr char BINARY_GRAPH_MAGIC[4] = { 'F', 'W', 'G', 'B' };
+constexpr uint32_t BINARY_GRAPH_VERSION = 1;
+constexpr uint32_t BINARY_GRAPH_WEIGHT_F64 = 0;
+
+static_assert(sizeof(Edge) == 16 && sizeof(BinaryGraphHeader) == 40, "binary graph layout");
+
+struct ParsedEdge {
+    std::string_view from;
+    std::string_view to;
+    double weight;
+};
+
+inline bool IsBlank(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline std::string_view NextToken(std::string_view text, std::size_t& pos) {
+    while (pos < text.size() && IsBlank(text[pos])) {
+        ++pos;
+    }
+    const std::size_t begin = pos;
+    while (pos < text.size() && !IsBlank(text[pos])) {
+        ++pos;
+    }
+    return text.substr(begin, pos - begin);
+}
+
+inline bool ParseWeight(std::string_view token, double& weight) {
+    if (!token.empty() && token.front() == '+') {
+        token.remove_prefix(1);
+    }
+    const char* end = token.data() + token.size();
+    auto [ptr, ec] = std::from_chars(token.data(), end, weight);
+    return ec == std::errc() && ptr == end && std::isfinite(weight);
+}
+
+// Tokenizes "from to weight" triples in place. Like the stream-based
+// reader, parsing stops at the first triple that is incomplete or has a
+// malformed weight; returns false if that happened before the end of text.
+inline bool ParseEdgeChunk(std::string_view text, std::vector<ParsedEdge>& edges) {
+    std::size_t pos = 0;
+    for (;;) {
+        const std::string_view from = NextToken(text, pos);
+        if (from.empty()) {
+            return true;
+        }
+        const std::string_view to = NextToken(text, pos);
+        double weight;
+        if (to.empty() || !ParseWeight(NextToken(text, pos), weight)) {
+            return false;
+        }
+        edges.push_back({ from, to, weight });
+    }
+}
+
+// Splits text into at most `parts` pieces, each ending at a line break.
+inline std::vector<std::string_view> SplitAtLines(std::string_view text, std::size_t parts) {
+    std::vector<std::string_view> chunks;
+    std::size_t begin = 0;
+    for (std::size_t part = 1; part <= parts && begin < text.size(); ++part) {
+        std::size_t end = part == parts ? text.size() : std::max(begin, text.size() * part / parts);
+        end = std::min(text.find('\n', end), text.size());
+        if (end != text.size()) {
+            ++end;
+        }
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+// Tokenizes a whitespace-separated "from to weight" edge list in place;
+// names go from the mapping straight into the vertex dictionary. With more
+// than one thread the mapping is split at line breaks (so every edge must sit
+// on a single line) and the pieces are parsed concurrently, then interned in
+// file order so vertex ids come out the same as in a serial load.
+inline EdgeList ParseTextEdgeList(const MappedFile& file, std::size_t threads) {
+    const std::size_t min_chunk_size = 1 << 20;
+    ThreadPool pool(std::min(threads ? threads : std::thread::hardware_concurrency(),
+                             std::max<std::size_t>(1, file.size() / min_chunk_size)));
+    const std::vector<std::string_view> chunks = SplitAtLines(file.data(), pool.size());
+
+    std::vector<std::vector<ParsedEdge>> parsed(chunks.size());
+    std::vector<char> complete(chunks.size());
+    pool.ParallelFor(chunks.size(), [&](std::size_t c) {
+        parsed[c].reserve(chunks[c].size() / 8);
+        complete[c] = ParseEdgeChunk(chunks[c], parsed[c]);
+    });
+
+    EdgeList graph;
+    std::size_t edge_count = 0;
+    for (const auto& chunk : parsed) {
+        edge_count += chunk.size();
+    }
+    graph.edges.reserve(edge_count);
+
+    for (std::size_t c = 0; c < chunks.size(); ++c) {
+        for (const ParsedEdge& edge : parsed[c]) {
+            const uint32_t from = graph.vertices.Intern(edge.from);
+            const uint32_t to = graph.vertices.Intern(edge.to);
+            graph.edges.push_back({ from, to, edge.weight });
+        }
+        if (!complete[c]) {
+            break;
+        }
+    }
+    return graph;
+}
+
+inline bool IsBinaryGraph(std::string_view data) {
+    return data.size() >= sizeof(BINARY_GRAPH_MAGIC)
+        && std::memcmp(data.data(), BINARY_GRAPH_MAGIC, sizeof(BINARY_GRAPH_MAGIC)) == 0;
+}
+
+// Views a mapped binary graph without copying: names are interned as views
+// into the mapping and the edge records are used in place. With parts > 1
+// only the part-th of `parts` equal slices of the edge records is kept (and
+// read at all), for loaders that split the edges between processes; the
+// vertex table is always complete.
+inline EdgeList ReadBinaryEdgeList(std::shared_ptr<const MappedFile> file, std::size_t part = 0,
+                                   std::size_t parts = 1) {
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("Binary graphs are only supported on little-endian hosts");
+    }
+
+    const std::string_view data = file->data();
+    BinaryGraphHeader header;
+    if (data.size() < sizeof(header)) {
+        throw std::runtime_error("Truncated binary graph");
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.version != BINARY_GRAPH_VERSION || header.weight_type != BINARY_GRAPH_WEIGHT_F64) {
+        throw std::runtime_error("Unsupported binary graph version");
+    }
+
+    // Every field is checked against the file size on its own before fields
+    // are combined, so no sum or product below can wrap.
+    const uint64_t names_offset = sizeof(header) + uint64_t(header.vertex_count) * sizeof(uint64_t);
+    if (names_offset > data.size() || header.name_bytes > data.size() - names_offset
+        || header.edges_offset > data.size() || header.edges_offset < names_offset + header.name_bytes
+        || header.edges_offset % alignof(Edge) != 0
+        || header.edge_count > (data.size() - header.edges_offset) / sizeof(Edge)) {
+        throw std::runtime_error("Corrupt binary graph");
+    }
+
+    EdgeList graph;
+    graph.vertices.Reserve(header.vertex_count);
+    uint64_t name_begin = 0;
+    for (uint32_t v = 0; v < header.vertex_count; ++v) {
+        uint64_t name_end;
+        std::memcpy(&name_end, data.data() + sizeof(header) + v * sizeof(uint64_t), sizeof(name_end));
+        if (name_end < name_begin || name_end > header.name_bytes
+            || graph.vertices.InternView(data.substr(names_offset + name_begin, name_end - name_begin)) != v) {
+            throw std::runtime_error("Corrupt binary graph");
+        }
+        name_begin = name_end;
+    }
+
+    const uint64_t edges_begin = header.edge_count * part / parts;
+    const uint64_t edges_end = header.edge_count * (part + 1) / parts;
+    graph.mapped_edges = { reinterpret_cast<const Edge*>(data.data() + header.edges_offset) + edges_begin,
+                           edges_end - edges_begin };
+    for (const Edge& edge : graph.mapped_edges) {
+        if (edge.from >= header.vertex_count || edge.to >= header.vertex_count) {
+            throw std::runtime_error("Corrupt binary graph");
+        }
+    }
+    graph.vertices.KeepAlive(file);
+    graph.mapping = std::move(file);
+    return graph;
+}
+
+inline void WriteBinaryEdgeList(const EdgeList& graph, const std::string& file_name) {
+    std::ofstream file_out(file_name, std::ios::binary);
+    if (!file_out) {
+        throw std::runtime_error("Cannot open " + file_name + " for writing");
+    }
+
+    BinaryGraphHeader header = {};
+    std::memcpy(header.magic, BINARY_GRAPH_MAGIC, sizeof(header.magic));
+    header.version = BINARY_GRAPH_VERSION;
+    header.vertex_count = static_cast<uint32_t>(graph.vertices.size());
+    header.weight_type = BINARY_GRAPH_WEIGHT_F64;
+    header.edge_count = graph.Edges().size();
+
+    std::vector<uint64_t> name_end(graph.vertices.size());
+    for (uint32_t v = 0; v < header.vertex_count; ++v) {
+        header.name_bytes += graph.vertices.Name(v).size();
+        name_end[v] = header.name_bytes;
+    }
+    const uint64_t names_end = sizeof(header) + name_end.size() * sizeof(uint64_t) + header.name_bytes;
+    header.edges_offset = (names_end + alignof(Edge) - 1) / alignof(Edge) * alignof(Edge);
+
+    file_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_out.write(reinterpret_cast<const char*>(name_end.data()), name_end.size() * sizeof(uint64_t));
+    for (uint32_t v = 0; v < header.vertex_count; ++v) {
+        file_out.write(graph.vertices.Name(v).data(), graph.vertices.Name(v).size());
+    }
+    const char padding[alignof(Edge)] = {};
+    file_out.write(padding, header.edges_offset - names_end);
+    file_out.write(reinterpret_cast<const char*>(graph.Edges().data()), graph.Edges().size() * sizeof(Edge));
+    if (!file_out) {
+        throw std::runtime_error("Failed to write " + file_name);
+    }
+    FW_COUNT(Counter::BytesWritten, file_out.tellp());
+}
+
+// Writes the "from to weight" text format; weights are printed in their
+// shortest round-trip form, so loading the file gives back the same graph.
+inline void WriteTextEdgeList(const EdgeList& graph, const std::string& file_name) {
+    DistanceWriter file_out(file_name);
+    char digits[32];
+    for (const Edge& edge : graph.Edges()) {
+        file_out.Write(graph.vertices.Name(edge.from));
+        file_out.Write(' ');
+        file_out.Write(graph.vertices.Name(edge.to));
+        file_out.Write(' ');
+        const auto result = std::to_chars(digits, digits + sizeof(digits), edge.weight);
+        file_out.Write(std::string_view(digits, static_cast<std::size_t>(result.ptr - digits)));
+        file_out.Write('\n');
+    }
+    file_out.Close();
+}
+
+// Loads either format, telling them apart by the binary magic.
+inline EdgeList LoadEdgeList(const std::string& file_name, std::size_t threads = 1) {
+    FW_PHASE(Phase::InitEdges);
+    auto file = std::make_shared<const MappedFile>(file_name);
+    FW_COUNT(Counter::BytesRead, file->data().size());
+    if (IsBinaryGraph(file->data())) {
+        return ReadBinaryEdgeList(std::move(file));
+    }
+    return ParseTextEdgeList(*file, threads);
+}
+
+enum class WeightType {
+    Auto,
+    Int32,
+    Float,
+    Double,
+};
+
+// Picks the narrowest weight type in which every simple-path sum of the
+// graph is exact, so the result is identical to solving in double: int32 for
+// integral weights, float for binary fractions with a short enough mantissa.
+inline WeightType NarrowestWeightType(const EdgeList& graph) {
+    double max_abs = 0;
+    const std::span<const Edge> edges = graph.Edges();
+    for (const Edge& edge : edges) {
+        if (!std::isfinite(edge.weight)) {
+            return WeightType::Double;
+        }
+        max_abs = std::max(max_abs, std::abs(edge.weight));
+    }
+    const double path_bound = max_abs * static_cast<double>(std::max<std::size_t>(graph.vertices.size(), 2) - 1);
+
+    auto scaled_integral = [edges](int exponent) {
+        return std::all_of(edges.begin(), edges.end(), [exponent](const Edge& edge) {
+            const double scaled = std::ldexp(edge.weight, exponent);
+            return scaled == std::trunc(scaled);
+        });
+    };
+
+    if (path_bound < std::numeric_limits<int32_t>::max() && scaled_integral(0)) {
+        return WeightType::Int32;
+    }
+    for (int exponent = 0; exponent < std::numeric_limits<float>::digits; ++exponent) {
+        if (std::ldexp(path_bound, exponent) > std::ldexp(1.0, std::numeric_limits<float>::digits)) {
+            break;
+        }
+        if (scaled_integral(exponent)) {
+            return WeightType::Float;
+        }
+    }
+    return WeightType::Double;
+}
+
+// Calls func with std::type_identity of the weight type selected by `weight`.
+template<typename Func>
+void WithWeightType(WeightType weight, Func&& func) {
+    if (weight == WeightType::Int32) {
+        func(std::type_identity<int32_t>());
+    }
+    else if (weight == WeightType::Float) {
+        func(std::type_identity<float>());
+    }
+    else {
+        func(std::type_identity<double>());
+    }
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "dense_floyd_warshall.h"
+#include "edge_list.h"
+#include "instrumentation.h"
+#include "relax_kernels.h"
+#include "result_matrix.h"
+#include "vertex_dictionary.h"
+#include "weight_traits.h"
+
+// Floyd-Warshall on N vertices with both matrices in std::arrays and the
+// pivot loop unrolled at compile time, so every pivot's row offset and the
+// row length are constants. At run time rows are relaxed by the SIMD row
+// kernels of relax_kernels.h. Everything is also constexpr, with a scalar
+// row loop, so a graph known at compile time can be solved in a constant
+// expression:
+//     constexpr auto solved = [] {
+//         FloydWarshallFixed<3, int32_t> fw;
+//         fw.SetEdge(0, 1, 2);
+//         fw.SetEdge(1, 2, 3);
+//         fw.Solve();
+//         return fw;
+//     }();
+//     static_assert(solved.Distance(0, 2) == 5);
+// Relaxes in the same order as DenseKernel::Naive run on one thread, so the
+// matrices come out identical. Vertices without edges are isolated and leave
+// the others untouched, which lets one instance serve any graph of up to N
+// vertices.
+template<std::size_t N, typename Weight = double>
+class FloydWarshallFixed {
+public:
+    using Traits = WeightTraits<Weight>;
+
+    constexpr FloydWarshallFixed() {
+        dist_.fill(Traits::Infinity());
+        next_.fill(-1);
+        for (std::size_t v = 0; v < N; ++v) {
+            dist_[v * N + v] = 0;
+        }
+    }
+
+    // Later edges for the same pair win. A vertex stays at distance 0 from
+    // itself, as in the other engines.
+    constexpr void SetEdge(std::size_t from, std::size_t to, Weight weight) {
+        dist_[from * N + to] = from == to ? Weight(0) : weight;
+        next_[from * N + to] = static_cast<int32_t>(to);
+    }
+
+    // Relaxes through every pivot in order. With stop_at_negative_cycle the
+    // solve stops before the first pivot k with dist[k][k] < 0 and returns
+    // k; otherwise, or if there is none, it returns N. Without track_paths
+    // the successors are left as SetEdge wrote them.
+    constexpr std::size_t Solve(bool stop_at_negative_cycle = false, SimdLevel simd = SimdLevel::Auto,
+                                bool track_paths = true) {
+        RelaxRowFn<Weight> relax_row = nullptr;
+        if (!std::is_constant_evaluated()) {
+            relax_row = SelectRelaxRow<Weight>(simd, track_paths);
+        }
+        return SolvePivots(stop_at_negative_cycle, track_paths, relax_row, std::make_index_sequence<N>());
+    }
+
+    // Same marking as DenseFloydWarshall::MarkUnboundedPairs. Marking only
+    // turns finite distances into -INF, so it can be done in place.
+    constexpr void MarkUnboundedPairs() {
+        for (std::size_t i = 0; i < N; ++i) {
+            for (std::size_t c = 0; c < N; ++c) {
+                if (dist_[c * N + c] >= 0 || dist_[i * N + c] == Traits::Infinity()) {
+                    continue;
+                }
+                for (std::size_t j = 0; j < N; ++j) {
+                    if (dist_[c * N + j] != Traits::Infinity()) {
+                        dist_[i * N + j] = Traits::NegativeInfinity();
+                    }
+                }
+            }
+        }
+    }
+
+    constexpr Weight Distance(std::size_t from, std::size_t to) const {
+        return dist_[from * N + to];
+    }
+
+    constexpr int32_t Next(std::size_t from, std::size_t to) const {
+        return next_[from * N + to];
+    }
+
+private:
+    std::array<Weight, N * N> dist_ = {};
+    std::array<int32_t, N * N> next_ = {};
+
+    template<std::size_t... K>
+    constexpr std::size_t SolvePivots(bool stop_at_negative_cycle, bool track_paths,
+                                      RelaxRowFn<Weight> relax_row, std::index_sequence<K...>) {
+        std::size_t stopped = N;
+        // || visits the pivots left to right and stops at the first cycle.
+        static_cast<void>(((RelaxPivot<K>(stop_at_negative_cycle, track_paths, relax_row) && (stopped = K, true)) || ...));
+        return stopped;
+    }
+
+    // Returns true instead of relaxing when stopping at a cycle through K.
+    // relax_row is null in constant evaluation.
+    template<std::size_t K>
+    constexpr bool RelaxPivot(bool stop_at_negative_cycle, bool track_paths, RelaxRowFn<Weight> relax_row) {
+        if (stop_at_negative_cycle && dist_[K * N + K] < 0) {
+            return true;
+        }
+        for (std::size_t i = 0; i < N; ++i) {
+            const Weight i_k = dist_[i * N + K];
+            if (i_k == Traits::Infinity()) {
+                continue;
+            }
+            const int32_t next_ik = track_paths ? next_[i * N + K] : -1;
+            if (relax_row) {
+                FW_COUNT(Counter::Relaxations, N);
+                relax_row(&dist_[i * N], &next_[i * N], &dist_[K * N], i_k, next_ik, 0, N);
+                continue;
+            }
+            for (std::size_t j = 0; j < N; ++j) {
+                const Weight candidate = Traits::Add(i_k, dist_[K * N + j]);
+                if (candidate < dist_[i * N + j]) {
+                    dist_[i * N + j] = candidate;
+                    if (track_paths) {
+                        next_[i * N + j] = next_ik;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+};
+
+static_assert([] {
+    FloydWarshallFixed<3, int32_t> fw;
+    fw.SetEdge(0, 1, 2);
+    fw.SetEdge(1, 2, 3);
+    fw.Solve();
+    return fw.Distance(0, 2) == 5 && fw.Next(0, 2) == 1 && fw.Distance(2, 0) == WeightTraits<int32_t>::Infinity();
+}());
+
+// Graphs of up to this many vertices are solved by SmallFloydWarshall.
+constexpr std::size_t FIXED_MAX_VERTICES = 32;
+
+// The DenseFloydWarshall interface over FloydWarshallFixed, for graphs of
+// at most FIXED_MAX_VERTICES vertices, with the same results as the naive
+// kernel. The instance is sized to the next of 4, 8, 16 or 32 vertices, so
+// only four solvers are compiled per weight type. Uses the simd,
+// track_paths and negative_cycles fields of DenseOptions.
+template<typename Weight = double>
+class SmallFloydWarshall {
+public:
+    SmallFloydWarshall(EdgeList graph, const DenseOptions& options = {})
+        : options_(options), vertices_(std::move(graph.vertices)) {
+        FW_PHASE(Phase::InitDistanceMatrix);
+        const std::size_t n = vertices_.size();
+        if (n > FIXED_MAX_VERTICES) {
+            throw std::invalid_argument("SmallFloydWarshall takes at most 32 vertices");
+        }
+        if (n > 16) {
+            matrices_.template emplace<FloydWarshallFixed<32, Weight>>();
+        }
+        else if (n > 8) {
+            matrices_.template emplace<FloydWarshallFixed<16, Weight>>();
+        }
+        else if (n > 4) {
+            matrices_.template emplace<FloydWarshallFixed<8, Weight>>();
+        }
+        std::visit([&](auto& fixed) {
+            for (const Edge& edge : graph.Edges()) {
+                fixed.SetEdge(edge.from, edge.to, static_cast<Weight>(edge.weight));
+            }
+        }, matrices_);
+        CopyMatrices();
+    }
+
+    void GenerateDistanceMatrix() {
+        FW_PHASE(Phase::GenerateDistanceMatrix);
+        std::visit([&](auto& fixed) {
+            const std::size_t stopped =
+                fixed.Solve(options_.negative_cycles == NegativeCyclePolicy::Fail, options_.simd, options_.track_paths);
+            if (stopped < vertices_.size()) {
+                ThrowNegativeCycle(fixed, stopped);
+            }
+            fixed.MarkUnboundedPairs();
+        }, matrices_);
+        CopyMatrices();
+    }
+
+    const VertexDictionary& Vertices() const {
+        return vertices_;
+    }
+
+    Weight Distance(VertexDictionary::Id from, VertexDictionary::Id to) const {
+        return std::visit([&](const auto& fixed) { return fixed.Distance(from, to); }, matrices_);
+    }
+
+    DistanceMatrixView<Weight> Result() const {
+        return { vertices_, dist_matrix_, next_vertex_ };
+    }
+
+    void PrintDistances(const std::string& file_name) const {
+        PrintDistanceMatrix<Weight>("output/" + file_name, Result());
+    }
+
+    void SaveResultMatrix(const std::string& file_name) const {
+        WriteResultMatrix<Weight>("output/" + file_name, Result());
+    }
+
+private:
+    DenseOptions options_;
+    VertexDictionary vertices_;
+    std::variant<FloydWarshallFixed<4, Weight>, FloydWarshallFixed<8, Weight>, FloydWarshallFixed<16, Weight>,
+                 FloydWarshallFixed<32, Weight>>
+        matrices_;
+    // The V x V corners of the fixed matrices, in the layout of
+    // DenseFloydWarshall; next is empty when paths are not tracked.
+    std::vector<Weight> dist_matrix_;
+    std::vector<int32_t> next_vertex_;
+
+    void CopyMatrices() {
+        const std::size_t n = vertices_.size();
+        dist_matrix_.resize(n * n);
+        next_vertex_.resize(options_.track_paths ? n * n : 0);
+        std::visit([&](const auto& fixed) {
+            for (std::size_t i = 0; i < n; ++i) {
+                for (std::size_t j = 0; j < n; ++j) {
+                    dist_matrix_[i * n + j] = fixed.Distance(i, j);
+                    if (options_.track_paths) {
+                        next_vertex_[i * n + j] = fixed.Next(i, j);
+                    }
+                }
+            }
+        }, matrices_);
+    }
+
+    // Reports the cycle as DenseFloydWarshall::CheckNegativeCycle does.
+    template<typename Fixed>
+    [[noreturn]] void ThrowNegativeCycle(const Fixed& fixed, std::size_t k) const {
+        const std::size_t n = vertices_.size();
+        std::vector<bool> affected(n);
+        for (std::size_t v = 0; v < n; ++v) {
+            affected[v] = fixed.Distance(v, v) < 0;
+        }
+        if (options_.track_paths) {
+            std::size_t current = k;
+            for (std::size_t steps = 0; steps < n && fixed.Next(current, k) >= 0; ++steps) {
+                current = static_cast<std::size_t>(fixed.Next(current, k));
+                affected[current] = true;
+                if (current == k) {
+                    break;
+                }
+            }
+        }
+
+        std::vector<std::string> on_cycle;
+        for (std::size_t v = 0; v < n; ++v) {
+            if (affected[v]) {
+                on_cycle.emplace_back(vertices_.Name(v));
+            }
+        }
+        throw NegativeCycleException(std::move(on_cycle));
+    }
+};
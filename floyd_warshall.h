@@ -0,0 +1,182 @@
+#pragma once
+
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "edge_list.h"
+#include "instrumentation.h"
+#include "vertex_dictionary.h"
+
+const double DOUBLE_MAX = std::numeric_limits<double>::max();
+
+class CycleDetectedException : public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "Cycle detected in the graph!";
+    }
+};
+
+class FloydWarshall {
+public:
+    FloydWarshall(const std::string& file_name) {
+        InitEdges("input/" + file_name);
+        InitDistanceMatrix();
+    }
+
+    // For a graph already in memory; gives the same result as loading it
+    // from a file with the same edges.
+    explicit FloydWarshall(const EdgeList& graph) {
+        InitEdges(graph);
+        InitDistanceMatrix();
+    }
+
+    void GenerateDistanceMatrix() {
+        FW_PHASE(Phase::GenerateDistanceMatrix);
+        for_each_vertex([this](const std::string& k) {
+            for_each_vertex_pair([this, k](const std::string& i, const std::string& j) {
+                double i_k = dist_matrix_[{i, k}];
+                double k_j = dist_matrix_[{k, j}];
+                double i_j = dist_matrix_[{i, j}];
+
+                FW_COUNT(Counter::Relaxations, 1);
+                if (i_k < DOUBLE_MAX && k_j < DOUBLE_MAX && i_k + k_j < i_j) {
+                    FW_COUNT(Counter::Updates, 1);
+                    dist_matrix_[{i, j}] = i_k + k_j;
+                    next_vertex_[{i, j}] = next_vertex_[{i, k}];
+                }
+            });
+        });
+    }
+
+    // DOUBLE_MAX when `to` is unreachable from `from`.
+    double Distance(const std::string& from, const std::string& to) const {
+        return dist_matrix_.at({ from, to });
+    }
+
+    void PrintDistances(const std::string& file_name) {
+        std::ofstream file_out("output/" + file_name);
+        PrintDistances(file_out);
+        FW_COUNT(Counter::BytesWritten, file_out.tellp());
+        file_out.close();
+    }
+
+    void PrintDistances(std::ostream& out) {
+        FW_PHASE(Phase::PrintDistances);
+        for_each_vertex_pair([this, &out](const std::string& lhs, const std::string& rhs) {
+            double dist = dist_matrix_[{lhs, rhs}];
+            if (lhs != rhs) {
+                out << "from: " << lhs << " to: " << rhs;
+                if (dist == DOUBLE_MAX) {
+                    out << " - INF\n";
+                }
+                else {
+                    out << " - " << dist << " via path: " << GetPath(lhs, rhs) << "\n";
+                }
+            }
+        });
+    }
+
+private:
+    // Every map node comes from this arena and the object is torn down in
+    // one release instead of V^2 frees. Declared first so it outlives both
+    // maps.
+    std::pmr::monotonic_buffer_resource arena_;
+    std::pmr::map<std::pair<std::string, std::string>, double> dist_matrix_{ &arena_ };
+    std::pmr::map<std::pair<std::string, std::string>, std::string> next_vertex_{ &arena_ };
+    std::vector<std::string> vertices_;
+    VertexDictionary vertex_ids_;
+
+    void InitDistanceMatrix() {
+        FW_PHASE(Phase::InitDistanceMatrix);
+        for_each_vertex_pair([this](const std::string& lhs, const std::string& rhs) {
+            if (lhs == rhs) {
+                dist_matrix_[{lhs, lhs}] = 0;
+            }
+            else if (!dist_matrix_.count({ lhs, rhs })) {
+                dist_matrix_[{lhs, rhs}] = DOUBLE_MAX;
+            }
+        });
+    }
+
+    void InitEdges(const std::string& file_name) {
+        FW_PHASE(Phase::InitEdges);
+        FW_COUNT(Counter::BytesRead, Instrumentation::FileBytes(file_name));
+        std::ifstream input_file(file_name);
+        std::string lhs, rhs;
+        double w;
+
+        while (input_file >> lhs >> rhs >> w) {
+            dist_matrix_[{lhs, rhs}] = w;
+            next_vertex_[{lhs, rhs}] = rhs;
+            if (vertex_ids_.Intern(lhs) == vertices_.size()) {
+                vertices_.push_back(lhs);
+            }
+            if (vertex_ids_.Intern(rhs) == vertices_.size()) {
+                vertices_.push_back(rhs);
+            }
+        }
+
+        input_file.close();
+    }
+
+    void InitEdges(const EdgeList& graph) {
+        FW_PHASE(Phase::InitEdges);
+        for (VertexDictionary::Id v = 0; v < graph.vertices.size(); ++v) {
+            vertices_.emplace_back(graph.vertices.Name(v));
+            vertex_ids_.Intern(vertices_.back());
+        }
+        for (const Edge& edge : graph.Edges()) {
+            const std::string& lhs = vertices_[edge.from];
+            const std::string& rhs = vertices_[edge.to];
+            dist_matrix_[{lhs, rhs}] = edge.weight;
+            next_vertex_[{lhs, rhs}] = rhs;
+        }
+    }
+
+    template<typename Func>
+    void for_each_vertex_pair(Func func) const {
+        for (const auto& lhs : vertices_) {
+            for (const auto& rhs : vertices_) {
+                func(lhs, rhs);
+            }
+        }
+    }
+
+    template<typename Func>
+    void for_each_vertex(Func func) const {
+        for (const auto& v : vertices_) {
+            func(v);
+        }
+    }
+
+    std::string GetPath(const std::string& start, const std::string& end) const {
+        if (dist_matrix_.at({ start, end }) == DOUBLE_MAX) {
+            return "No path";
+        }
+
+        std::string path = start;
+        std::string current = start;
+        std::vector<bool> visited(vertices_.size());
+        visited[vertex_ids_.Find(start)] = true;
+
+        while (current != end) {
+            current = next_vertex_.at({ current, end });
+            if (current != end) {
+                const VertexDictionary::Id id = vertex_ids_.Find(current);
+                if (visited[id]) {
+                    throw CycleDetectedException();
+                }
+                visited[id] = true;
+            }
+            path += "-" + current;
+        }
+
+        return path;
+    }
+};
@@ -0,0 +1,149 @@
+#include <mpi.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "command_line.h"
+#include "distributed_floyd_warshall.h"
+#include "edge_list.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
+
+// Solves one graph on every rank of MPI_COMM_WORLD with
+// DistributedFloydWarshall, e.g.
+//     mpirun -np 16 floyd_warshall_mpi roads.fwgb roads.fwrm --tile=512
+// The graph must be in the binary format (see convert_graph), since each
+// rank reads only its own slice of it, and the result is always written in
+// the binary result format.
+
+void PrintUsage() {
+    std::cerr << "Usage: floyd_warshall_mpi <BinaryGraphToLoad> <FileNameToSave> [options]\n"
+              << "  --tile=N\n"
+              << "  --simd=auto|scalar|avx2|avx512\n"
+              << "  --threads=N (per rank)\n"
+              << "  --weight=auto|int32|float|double\n"
+              << "  --distances-only\n"
+              << "  --negative-cycles=fail|mark" << std::endl;
+}
+
+struct Options {
+    std::string input;
+    std::string output;
+    DenseOptions dense;
+    WeightType weight = WeightType::Auto;
+};
+
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--tile=", 0) == 0) {
+            if (!ParseCount(arg.substr(7), options.dense.tile_size)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--threads=", 0) == 0) {
+            if (!ParseCount(arg.substr(10), options.dense.threads)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--simd=", 0) == 0) {
+            if (!ParseSimdLevel(arg.substr(7), options.dense.simd)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--weight=", 0) == 0) {
+            if (!ParseWeightType(arg.substr(9), options.weight)) {
+                return false;
+            }
+        }
+        else if (arg == "--negative-cycles=fail") {
+            options.dense.negative_cycles = NegativeCyclePolicy::Fail;
+        }
+        else if (arg == "--negative-cycles=mark") {
+            options.dense.negative_cycles = NegativeCyclePolicy::Mark;
+        }
+        else if (arg == "--distances-only") {
+            options.dense.track_paths = false;
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return false;
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        return false;
+    }
+    options.input = positional[0];
+    options.output = positional[1];
+    return true;
+}
+
+void Solve(const Options& options, int rank, int ranks) {
+    auto file = std::make_shared<const MappedFile>("input/" + options.input);
+    if (!IsBinaryGraph(file->data())) {
+        throw std::runtime_error(options.input + " is not a binary graph; convert it with convert_graph first");
+    }
+    EdgeList part = ReadBinaryEdgeList(std::move(file), static_cast<std::size_t>(rank), static_cast<std::size_t>(ranks));
+    const WeightType weight =
+        options.weight == WeightType::Auto ? NarrowestWeightType(part, MPI_COMM_WORLD) : options.weight;
+
+    WithWeightType(weight, [&](auto type) {
+        using Weight = typename decltype(type)::type;
+        DistributedFloydWarshall<Weight> FW(MPI_COMM_WORLD, std::move(part), options.dense);
+        FW.GenerateDistanceMatrix();
+        FW.SaveResultMatrix(options.output);
+    });
+}
+
+int main(int argc, char* argv[]) {
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank = 0;
+    int ranks = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        if (rank == 0) {
+            PrintUsage();
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    int status = 0;
+    try {
+        // Counters are per process; the report shows rank 0's share.
+        if (rank == 0) {
+            FW_REPORT_RUN(std::cerr);
+            Solve(options, rank, ranks);
+        }
+        else {
+            Solve(options, rank, ranks);
+        }
+    }
+    catch (const CycleDetectedException& e) {
+        // Raised on every rank together, so the ranks can shut down cleanly.
+        if (rank == 0) {
+            std::cerr << e.what() << std::endl;
+        }
+        status = 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "An error occurred on rank " << rank << ": " << e.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (status == 0 && rank == 0) {
+        std::cout << "Success!\n";
+    }
+    MPI_Finalize();
+    return status;
+}
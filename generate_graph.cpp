@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+
+#include "command_line.h"
+#include "edge_list.h"
+#include "graph_generator.h"
+
+// Writes a synthetic graph in the text or binary edge-list format. The same
+// options and seed always produce the same file.
+
+void PrintUsage() {
+    std::cerr << "Usage: generate_graph [options] <OutputFile>\n"
+              << "  --vertices=N          default 1000\n"
+              << "  --density=P           probability of each ordered pair, default 0.1\n"
+              << "  --min-weight=W --max-weight=W   base weight range, default 1..100\n"
+              << "  --potentials=R        shift weights by vertex potentials in [0, R]; gives\n"
+              << "                        negative edges but no negative cycle when min-weight >= 0\n"
+              << "  --negative-cycle      plant a cycle of total weight -1\n"
+              << "  --seed=N              default 1\n"
+              << "  --format=text|binary  default text" << std::endl;
+}
+
+bool ParseOptions(int argc, char* argv[], GraphSpec& spec, bool& binary, std::string& output) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            if (!output.empty()) {
+                return false;
+            }
+            output = arg;
+            continue;
+        }
+        const std::size_t eq = arg.find('=');
+        const std::string name = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (name == "--vertices") {
+            if (!ParseCount(value, spec.vertices)) {
+                return false;
+            }
+        }
+        else if (name == "--density") {
+            if (!ParseDensity(value, spec.density)) {
+                return false;
+            }
+        }
+        else if (name == "--min-weight") {
+            if (!ParseInt32(value, spec.min_weight)) {
+                return false;
+            }
+        }
+        else if (name == "--max-weight") {
+            if (!ParseInt32(value, spec.max_weight)) {
+                return false;
+            }
+        }
+        else if (name == "--potentials") {
+            if (!ParseInt32(value, spec.potential_range) || spec.potential_range < 0) {
+                return false;
+            }
+        }
+        else if (name == "--negative-cycle" && eq == std::string::npos) {
+            spec.negative_cycle = true;
+        }
+        else if (name == "--seed") {
+            std::size_t seed;
+            if (!ParseCount(value, seed)) {
+                return false;
+            }
+            spec.seed = seed;
+        }
+        else if (name == "--format") {
+            if (value != "text" && value != "binary") {
+                return false;
+            }
+            binary = value == "binary";
+        }
+        else {
+            return false;
+        }
+    }
+    return !output.empty() && spec.min_weight <= spec.max_weight;
+}
+
+int main(int argc, char* argv[]) {
+    GraphSpec spec;
+    bool binary = false;
+    std::string output;
+    if (!ParseOptions(argc, argv, spec, binary, output)) {
+        PrintUsage();
+        return 1;
+    }
+
+    try {
+        const EdgeList graph = GenerateGraph(spec);
+        if (binary) {
+            WriteBinaryEdgeList(graph, output);
+        }
+        else {
+            WriteTextEdgeList(graph, output);
+        }
+        std::cout << graph.vertices.size() << " vertices, " << graph.Edges().size() << " edges" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
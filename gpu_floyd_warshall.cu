@@ -0,0 +1,220 @@
+// Compile with
+//     nvcc -O3 -std=c++17 --expt-relaxed-constexpr -DFW_WITH_CUDA -c gpu_floyd_warshall.cu
+// and link the object and -lcudart into a build of main.cpp that also
+// defines FW_WITH_CUDA.
+
+#include <cuda_runtime.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "gpu_floyd_warshall.h"
+#include "weight_traits.h"
+
+namespace {
+
+// One thread per cell of a TILE x TILE tile; 32 x 32 is the largest square
+// block CUDA allows and keeps the phase three working set at 20 KiB of
+// shared memory for double.
+constexpr int TILE = 32;
+
+void Check(cudaError_t status) {
+    if (status != cudaSuccess) {
+        throw std::runtime_error(std::string("CUDA error: ") + cudaGetErrorString(status));
+    }
+}
+
+template<typename T>
+class DeviceBuffer {
+public:
+    explicit DeviceBuffer(std::size_t count) {
+        if (count) {
+            Check(cudaMalloc(&data_, count * sizeof(T)));
+        }
+    }
+
+    DeviceBuffer(const DeviceBuffer&) = delete;
+    DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+
+    ~DeviceBuffer() {
+        if (data_) {
+            cudaFree(data_);
+        }
+    }
+
+    T* get() const {
+        return data_;
+    }
+
+private:
+    T* data_ = nullptr;
+};
+
+template<typename Weight>
+__device__ void LoadTile(const Weight* dist, const int32_t* next, int n, int i, int j, Weight& d, int32_t& s) {
+    const bool inside = i < n && j < n;
+    const std::size_t cell = static_cast<std::size_t>(i) * n + j;
+    d = inside ? dist[cell] : WeightTraits<Weight>::Infinity();
+    s = inside && next ? next[cell] : -1;
+}
+
+template<typename Weight>
+__device__ void StoreTile(Weight* dist, int32_t* next, int n, int i, int j, Weight d, int32_t s) {
+    if (i < n && j < n) {
+        const std::size_t cell = static_cast<std::size_t>(i) * n + j;
+        dist[cell] = d;
+        if (next) {
+            next[cell] = s;
+        }
+    }
+}
+
+// Phase one: closes the pivot tile (b, b) over its own pivots, in order.
+template<typename Weight>
+__global__ void DiagonalTile(Weight* dist, int32_t* next, int n, int b) {
+    __shared__ Weight d[TILE][TILE];
+    __shared__ int32_t s[TILE][TILE];
+    const int ty = threadIdx.y;
+    const int tx = threadIdx.x;
+    const int i = b * TILE + ty;
+    const int j = b * TILE + tx;
+    LoadTile(dist, next, n, i, j, d[ty][tx], s[ty][tx]);
+    __syncthreads();
+
+    for (int k = 0; k < TILE; ++k) {
+        const Weight candidate = WeightTraits<Weight>::Add(d[ty][k], d[k][tx]);
+        const int32_t via = s[ty][k];
+        __syncthreads();
+        if (candidate < d[ty][tx]) {
+            d[ty][tx] = candidate;
+            s[ty][tx] = via;
+        }
+        __syncthreads();
+    }
+    StoreTile(dist, next, n, i, j, d[ty][tx], s[ty][tx]);
+}
+
+// Phase two: the tiles in pivot row b (blockIdx.y == 0) and pivot column b
+// (blockIdx.y == 1), each relaxed through the closed pivot tile. A row tile
+// takes its first hops from the pivot tile, a column tile from itself.
+template<typename Weight>
+__global__ void PivotRowAndColumn(Weight* dist, int32_t* next, int n, int b) {
+    const int t = static_cast<int>(blockIdx.x);
+    if (t == b) {
+        return;
+    }
+    __shared__ Weight pivot[TILE][TILE];
+    __shared__ int32_t pivot_next[TILE][TILE];
+    __shared__ Weight d[TILE][TILE];
+    __shared__ int32_t s[TILE][TILE];
+    const int ty = threadIdx.y;
+    const int tx = threadIdx.x;
+    const bool row = blockIdx.y == 0;
+    const int i = (row ? b : t) * TILE + ty;
+    const int j = (row ? t : b) * TILE + tx;
+    LoadTile(dist, next, n, b * TILE + ty, b * TILE + tx, pivot[ty][tx], pivot_next[ty][tx]);
+    LoadTile(dist, next, n, i, j, d[ty][tx], s[ty][tx]);
+    __syncthreads();
+
+    for (int k = 0; k < TILE; ++k) {
+        const Weight candidate = row ? WeightTraits<Weight>::Add(pivot[ty][k], d[k][tx])
+                                     : WeightTraits<Weight>::Add(d[ty][k], pivot[k][tx]);
+        const int32_t via = row ? pivot_next[ty][k] : s[ty][k];
+        __syncthreads();
+        if (candidate < d[ty][tx]) {
+            d[ty][tx] = candidate;
+            s[ty][tx] = via;
+        }
+        __syncthreads();
+    }
+    StoreTile(dist, next, n, i, j, d[ty][tx], s[ty][tx]);
+}
+
+// Phase three: every other tile (I, J) reads only the final tiles (I, b)
+// and (b, J), so each thread keeps its cell in registers and no
+// synchronisation is needed inside the pivot loop.
+template<typename Weight>
+__global__ void RemainingTiles(Weight* dist, int32_t* next, int n, int b) {
+    if (static_cast<int>(blockIdx.x) == b || static_cast<int>(blockIdx.y) == b) {
+        return;
+    }
+    __shared__ Weight row_tile[TILE][TILE];
+    __shared__ int32_t row_next[TILE][TILE];
+    __shared__ Weight column_tile[TILE][TILE];
+    const int ty = threadIdx.y;
+    const int tx = threadIdx.x;
+    const int i = blockIdx.y * TILE + ty;
+    const int j = blockIdx.x * TILE + tx;
+    int32_t unused;
+    LoadTile(dist, next, n, i, b * TILE + tx, row_tile[ty][tx], row_next[ty][tx]);
+    LoadTile(dist, static_cast<const int32_t*>(nullptr), n, b * TILE + ty, j, column_tile[ty][tx], unused);
+    Weight d;
+    int32_t s;
+    LoadTile(dist, next, n, i, j, d, s);
+    __syncthreads();
+
+    for (int k = 0; k < TILE; ++k) {
+        const Weight candidate = WeightTraits<Weight>::Add(row_tile[ty][k], column_tile[k][tx]);
+        if (candidate < d) {
+            d = candidate;
+            s = row_next[ty][k];
+        }
+    }
+    StoreTile(dist, next, n, i, j, d, s);
+}
+
+template<typename Weight>
+void Solve(Weight* dist, int32_t* next, std::size_t n) {
+    if (n == 0) {
+        return;
+    }
+    const std::size_t cells = n * n;
+    DeviceBuffer<Weight> device_dist(cells);
+    DeviceBuffer<int32_t> device_next(next ? cells : 0);
+    Check(cudaMemcpy(device_dist.get(), dist, cells * sizeof(Weight), cudaMemcpyHostToDevice));
+    if (next) {
+        Check(cudaMemcpy(device_next.get(), next, cells * sizeof(int32_t), cudaMemcpyHostToDevice));
+    }
+
+    const int size = static_cast<int>(n);
+    const int blocks = (size + TILE - 1) / TILE;
+    const dim3 threads(TILE, TILE);
+    for (int b = 0; b < blocks; ++b) {
+        DiagonalTile<<<1, threads>>>(device_dist.get(), device_next.get(), size, b);
+        PivotRowAndColumn<<<dim3(blocks, 2), threads>>>(device_dist.get(), device_next.get(), size, b);
+        RemainingTiles<<<dim3(blocks, blocks), threads>>>(device_dist.get(), device_next.get(), size, b);
+    }
+    Check(cudaGetLastError());
+    Check(cudaDeviceSynchronize());
+
+    Check(cudaMemcpy(dist, device_dist.get(), cells * sizeof(Weight), cudaMemcpyDeviceToHost));
+    if (next) {
+        Check(cudaMemcpy(next, device_next.get(), cells * sizeof(int32_t), cudaMemcpyDeviceToHost));
+    }
+}
+
+} // namespace
+
+bool GpuAvailable(std::size_t bytes) {
+    int devices = 0;
+    if (cudaGetDeviceCount(&devices) != cudaSuccess || devices == 0) {
+        return false;
+    }
+    std::size_t free_bytes = 0;
+    std::size_t total_bytes = 0;
+    return cudaMemGetInfo(&free_bytes, &total_bytes) == cudaSuccess && free_bytes >= bytes;
+}
+
+void GpuFloydWarshall(double* dist, int32_t* next, std::size_t n) {
+    Solve(dist, next, n);
+}
+
+void GpuFloydWarshall(float* dist, int32_t* next, std::size_t n) {
+    Solve(dist, next, n);
+}
+
+void GpuFloydWarshall(int32_t* dist, int32_t* next, std::size_t n) {
+    Solve(dist, next, n);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+// Blocked min-plus Floyd-Warshall on a CUDA device, used by DenseKernel::Gpu.
+// The kernels live in gpu_floyd_warshall.cu and are only compiled in with
+// -DFW_WITH_CUDA; without it GpuAvailable() is false and the dense engine
+// runs the CPU blocked kernel instead, so callers never need their own
+// #ifdef.
+//
+// GpuFloydWarshall copies the row-major n * n matrices to the device once,
+// runs every pivot block there and copies them back, with the same
+// semantics as the CPU kernels: WeightTraits infinities, saturating int32
+// sums, next[i][j] = next[i][k] on improvement, and next == nullptr for
+// distances only. An error from the CUDA runtime is thrown as
+// std::runtime_error. Experimental: no regular build compiles the .cu, so
+// the device path is only exercised on machines built with CUDA.
+
+#if defined(FW_WITH_CUDA)
+
+// Whether a device is present with at least `bytes` of free memory.
+bool GpuAvailable(std::size_t bytes = 0);
+
+void GpuFloydWarshall(double* dist, int32_t* next, std::size_t n);
+void GpuFloydWarshall(float* dist, int32_t* next, std::size_t n);
+void GpuFloydWarshall(int32_t* dist, int32_t* next, std::size_t n);
+
+#else
+
+inline bool GpuAvailable(std::size_t = 0) {
+    return false;
+}
+
+template<typename Weight>
+void GpuFloydWarshall(Weight*, int32_t*, std::size_t) {
+    throw std::logic_error("Built without FW_WITH_CUDA");
+}
+
+#endif
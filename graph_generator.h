@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "edge_list.h"
+
+// Deterministic synthetic graphs. The random stream is a fixed splitmix64
+// sequence mapped to values by hand rather than through <random>
+// distributions, whose output differs between standard libraries, so a seed
+// yields the same graph everywhere.
+struct GraphSpec {
+    std::size_t vertices = 1000;
+    // Probability of each ordered pair (u, v), u != v, being an edge.
+    double density = 0.1;
+    // Range of the base weight drawn for every edge.
+    int32_t min_weight = 1;
+    int32_t max_weight = 100;
+    // With potential_range > 0 every vertex gets a potential p(v) in
+    // [0, potential_range] and an edge weighs base + p(u) - p(v). Every cycle
+    // then weighs the sum of its base weights, so with min_weight >= 0 there
+    // are negative edges but no negative cycle.
+    int32_t potential_range = 0;
+    // Appends a cycle through up to three random vertices whose total weight
+    // is exactly -1, replacing any edges it overlaps.
+    bool negative_cycle = false;
+    uint64_t seed = 1;
+};
+
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed)
+        : state_(seed) {
+    }
+
+    uint64_t Next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in (0, 1].
+    double NextUnit() {
+        return static_cast<double>((Next() >> 11) + 1) * 0x1.0p-53;
+    }
+
+    // Uniform in [low, high].
+    int64_t NextInRange(int64_t low, int64_t high) {
+        return low + static_cast<int64_t>(Next() % static_cast<uint64_t>(high - low + 1));
+    }
+
+private:
+    uint64_t state_;
+};
+
+// Vertices are named v0 .. v{V-1}; edges come in (from, to) order, followed
+// by the planted cycle if any. Pairs are picked by geometric skips over the
+// V * (V - 1) candidates, so sparse graphs cost O(E) rather than O(V^2).
+inline EdgeList GenerateGraph(const GraphSpec& spec) {
+    if (spec.density < 0 || spec.density > 1 || spec.min_weight > spec.max_weight || spec.potential_range < 0) {
+        throw std::invalid_argument("Invalid graph spec");
+    }
+
+    EdgeList graph;
+    const std::size_t n = spec.vertices;
+    graph.vertices.Reserve(n);
+    for (std::size_t v = 0; v < n; ++v) {
+        graph.vertices.Intern("v" + std::to_string(v));
+    }
+    if (n < 2) {
+        return graph;
+    }
+
+    SplitMix64 random(spec.seed);
+    std::vector<int64_t> potential(n, 0);
+    if (spec.potential_range > 0) {
+        for (auto& p : potential) {
+            p = random.NextInRange(0, spec.potential_range);
+        }
+    }
+    auto weigh = [&potential](uint32_t from, uint32_t to, int64_t base) {
+        return static_cast<double>(base + potential[from] - potential[to]);
+    };
+
+    const uint64_t candidates = static_cast<uint64_t>(n) * (n - 1);
+    graph.edges.reserve(static_cast<std::size_t>(static_cast<double>(candidates) * spec.density * 1.05) + 16);
+    const double log_miss = std::log1p(-spec.density);
+    for (uint64_t pair = 0; spec.density > 0; ++pair) {
+        if (spec.density < 1) {
+            const double skip = std::floor(std::log(random.NextUnit()) / log_miss);
+            if (skip >= static_cast<double>(candidates - pair)) {
+                break;
+            }
+            pair += static_cast<uint64_t>(skip);
+        }
+        if (pair >= candidates) {
+            break;
+        }
+        const uint32_t from = static_cast<uint32_t>(pair / (n - 1));
+        uint32_t to = static_cast<uint32_t>(pair % (n - 1));
+        to += to >= from;
+        graph.edges.push_back({ from, to, weigh(from, to, random.NextInRange(spec.min_weight, spec.max_weight)) });
+    }
+
+    if (spec.negative_cycle) {
+        // Distinct vertices via a partial Fisher-Yates shuffle of the first
+        // three slots; two vertices give a 2-cycle.
+        const std::size_t length = std::min<std::size_t>(3, n);
+        std::vector<uint32_t> cycle(n);
+        for (std::size_t v = 0; v < n; ++v) {
+            cycle[v] = static_cast<uint32_t>(v);
+        }
+        for (std::size_t c = 0; c < length; ++c) {
+            std::swap(cycle[c], cycle[c + random.Next() % (n - c)]);
+        }
+        for (std::size_t c = 0; c < length; ++c) {
+            const uint32_t from = cycle[c];
+            const uint32_t to = cycle[(c + 1) % length];
+            graph.edges.push_back({ from, to, weigh(from, to, c + 1 == length ? -1 : 0) });
+        }
+    }
+    return graph;
+}
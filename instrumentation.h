@@ -0,0 +1,326 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Run instrumentation, selected at compile time. Built with
+// -DFW_INSTRUMENTATION the FW_PHASE, FW_COUNT and FW_REPORT_RUN macros
+// record per-phase wall time, relaxation and update counts and bytes read
+// and written, and the report adds peak RSS. -DFW_PERF_EVENTS additionally
+// reads cycles, instructions and cache misses through perf_event_open on
+// Linux. Without FW_INSTRUMENTATION the macros expand to nothing and their
+// arguments are never evaluated.
+
+enum class Phase {
+    InitEdges,
+    InitDistanceMatrix,
+    GenerateDistanceMatrix,
+    PrintDistances,
+    Count,
+};
+
+enum class Counter {
+    // Candidate paths compared: one per (i, j) cell per pivot in the matrix
+    // engines, one per scanned edge in Johnson.
+    Relaxations,
+    // Relaxations that improved a distance.
+    Updates,
+    BytesRead,
+    BytesWritten,
+    Count,
+};
+
+#if defined(FW_INSTRUMENTATION)
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#if defined(FW_PERF_EVENTS) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Counters live in one block per thread, written only by their owner with
+// plain relaxed loads and stores, so counting costs no atomic read-modify-
+// write and no shared cache line. Collect() sums the live blocks and the
+// totals left behind by threads that exited.
+class Instrumentation {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Totals {
+        std::array<double, static_cast<std::size_t>(Phase::Count)> phase_ms = {};
+        std::array<uint64_t, static_cast<std::size_t>(Counter::Count)> counters = {};
+    };
+
+    static void Add(Counter counter, uint64_t amount) {
+        std::atomic<uint64_t>& value = Local().counters[static_cast<std::size_t>(counter)];
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    static void AddTime(Phase phase, Clock::duration elapsed) {
+        std::atomic<int64_t>& value = Local().phase_ns[static_cast<std::size_t>(phase)];
+        value.store(value.load(std::memory_order_relaxed)
+                        + std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                    std::memory_order_relaxed);
+    }
+
+    static Totals Collect() {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        Totals totals = registry.retired;
+        for (const Block* block : registry.blocks) {
+            block->AddTo(totals);
+        }
+        return totals;
+    }
+
+    static void Reset() {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.retired = {};
+        for (Block* block : registry.blocks) {
+            block->Clear();
+        }
+    }
+
+    // Peak resident set size in KiB, 0 where getrusage is unavailable.
+    static uint64_t PeakRssKib() {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage = {};
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+            return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+            return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+        }
+#endif
+        return 0;
+    }
+
+    static uint64_t FileBytes(const std::string& file_name) {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(file_name, error);
+        return error ? 0 : static_cast<uint64_t>(size);
+    }
+
+private:
+    struct Block {
+        std::array<std::atomic<int64_t>, static_cast<std::size_t>(Phase::Count)> phase_ns = {};
+        std::array<std::atomic<uint64_t>, static_cast<std::size_t>(Counter::Count)> counters = {};
+
+        Block() {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.blocks.push_back(this);
+        }
+
+        ~Block() {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            AddTo(registry.retired);
+            std::erase(registry.blocks, this);
+        }
+
+        void AddTo(Totals& totals) const {
+            for (std::size_t p = 0; p < phase_ns.size(); ++p) {
+                totals.phase_ms[p] += static_cast<double>(phase_ns[p].load(std::memory_order_relaxed)) / 1e6;
+            }
+            for (std::size_t c = 0; c < counters.size(); ++c) {
+                totals.counters[c] += counters[c].load(std::memory_order_relaxed);
+            }
+        }
+
+        void Clear() {
+            for (auto& value : phase_ns) {
+                value.store(0, std::memory_order_relaxed);
+            }
+            for (auto& value : counters) {
+                value.store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<Block*> blocks;
+        Totals retired;
+    };
+
+    static Registry& GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    static Block& Local() {
+        thread_local Block block;
+        return block;
+    }
+};
+
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase phase)
+        : phase_(phase), start_(Instrumentation::Clock::now()) {
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    ~PhaseTimer() {
+        Instrumentation::AddTime(phase_, Instrumentation::Clock::now() - start_);
+    }
+
+private:
+    Phase phase_;
+    Instrumentation::Clock::time_point start_;
+};
+
+// Process-wide hardware counters, inherited by threads created after Start,
+// so the solver's thread pool is included. Any event the kernel refuses
+// (no PMU in a VM, perf_event_paranoid) is reported as unavailable.
+class PerfCounters {
+public:
+    enum Event {
+        Cycles,
+        Instructions,
+        CacheReferences,
+        CacheMisses,
+        EventCount,
+    };
+
+    PerfCounters() {
+        fds_.fill(-1);
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#if defined(FW_PERF_EVENTS) && defined(__linux__)
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    void Start() {
+#if defined(FW_PERF_EVENTS) && defined(__linux__)
+        static constexpr uint64_t CONFIGS[EventCount] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_REFERENCES,
+            PERF_COUNT_HW_CACHE_MISSES,
+        };
+        for (int e = 0; e < EventCount; ++e) {
+            perf_event_attr attr = {};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = CONFIGS[e];
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds_[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    // False if the event could not be opened or read.
+    bool Read(Event event, uint64_t& value) const {
+#if defined(FW_PERF_EVENTS) && defined(__linux__)
+        return fds_[event] >= 0 && read(fds_[event], &value, sizeof(value)) == sizeof(value);
+#else
+        (void)event;
+        (void)value;
+        return false;
+#endif
+    }
+
+private:
+    std::array<int, EventCount> fds_;
+};
+
+// Resets the counters on construction and prints the run's totals when it
+// goes out of scope.
+class RunReport {
+public:
+    explicit RunReport(std::ostream& out)
+        : out_(out) {
+        Instrumentation::Reset();
+        perf_.Start();
+    }
+
+    RunReport(const RunReport&) = delete;
+    RunReport& operator=(const RunReport&) = delete;
+
+    ~RunReport() {
+        static constexpr const char* PHASE_NAMES[] = { "InitEdges", "InitDistanceMatrix", "GenerateDistanceMatrix",
+                                                       "PrintDistances" };
+        static constexpr const char* COUNTER_NAMES[] = { "relaxations", "updates", "bytes_read", "bytes_written" };
+
+        const Instrumentation::Totals totals = Instrumentation::Collect();
+        out_ << "instrumentation:\n";
+        for (std::size_t p = 0; p < totals.phase_ms.size(); ++p) {
+            out_ << "  " << PHASE_NAMES[p] << "_ms " << totals.phase_ms[p] << '\n';
+        }
+        for (std::size_t c = 0; c < totals.counters.size(); ++c) {
+            out_ << "  " << COUNTER_NAMES[c] << ' ' << totals.counters[c] << '\n';
+        }
+        out_ << "  peak_rss_kib " << Instrumentation::PeakRssKib() << '\n';
+
+#if defined(FW_PERF_EVENTS)
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t references = 0;
+        uint64_t misses = 0;
+        if (perf_.Read(PerfCounters::Cycles, cycles) && perf_.Read(PerfCounters::Instructions, instructions)) {
+            out_ << "  cycles " << cycles << "\n  instructions " << instructions << "\n  ipc "
+                 << (cycles ? static_cast<double>(instructions) / static_cast<double>(cycles) : 0.0) << '\n';
+        }
+        else {
+            out_ << "  cycles unavailable\n  instructions unavailable\n";
+        }
+        if (perf_.Read(PerfCounters::CacheReferences, references) && perf_.Read(PerfCounters::CacheMisses, misses)) {
+            out_ << "  cache_references " << references << "\n  cache_misses " << misses << '\n';
+        }
+        else {
+            out_ << "  cache_misses unavailable\n";
+        }
+#endif
+        out_.flush();
+    }
+
+private:
+    std::ostream& out_;
+    PerfCounters perf_;
+};
+
+#define FW_CONCAT_INNER(a, b) a##b
+#define FW_CONCAT(a, b) FW_CONCAT_INNER(a, b)
+#define FW_PHASE(phase) PhaseTimer FW_CONCAT(fw_phase_timer_, __LINE__)(phase)
+#define FW_COUNT(counter, amount) Instrumentation::Add(counter, static_cast<uint64_t>(amount))
+#define FW_REPORT_RUN(out) RunReport FW_CONCAT(fw_run_report_, __LINE__)(out)
+
+#else
+
+#define FW_PHASE(phase) static_cast<void>(0)
+#define FW_COUNT(counter, amount) static_cast<void>(0)
+#define FW_REPORT_RUN(out) static_cast<void>(0)
+
+#endif
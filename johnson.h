@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dense_floyd_warshall.h"
+#include "edge_list.h"
+#include "instrumentation.h"
+#include "result_matrix.h"
+#include "reweighted_dijkstra.h"
+#include "thread_pool.h"
+#include "vertex_dictionary.h"
+#include "weight_traits.h"
+
+// Johnson's algorithm for sparse graphs: one Bellman-Ford pass from a virtual
+// source yields potentials h with w(u, v) + h(u) - h(v) >= 0 for every edge,
+// after which each source runs Dijkstra on the reweighted graph in
+// O(E log V). The sources are independent and are spread over the thread
+// pool. The result lands in the same matrices DenseFloydWarshall fills, so
+// output and queries are shared. Uses the threads, track_paths and
+// negative_cycles fields of DenseOptions; under NegativeCyclePolicy::Mark a
+// graph with a negative cycle is handed to DenseFloydWarshall, since
+// potentials do not exist there.
+template<typename Weight = double>
+class Johnson {
+public:
+    using Traits = WeightTraits<Weight>;
+
+    Johnson(const std::string& file_name, const DenseOptions& options = {})
+        : Johnson(LoadEdgeList("input/" + file_name, options.threads), options) {
+    }
+
+    Johnson(EdgeList graph, const DenseOptions& options = {})
+        : options_(options) {
+        InitEdges(std::move(graph));
+    }
+
+    void GenerateDistanceMatrix() {
+        FW_PHASE(Phase::GenerateDistanceMatrix);
+        if (!ComputePotentials()) {
+            SolveWithFallback();
+            return;
+        }
+
+        const std::size_t n = vertices_.size();
+        dist_matrix_.assign(n * n, Traits::Infinity());
+        if (options_.track_paths) {
+            next_vertex_.assign(n * n, -1);
+        }
+
+        if (options_.threads != 1) {
+            ThreadPool pool(options_.threads);
+            pool.ParallelFor(n, [this](std::size_t source) {
+                Dijkstra(source);
+            });
+        }
+        else {
+            for (std::size_t source = 0; source < n; ++source) {
+                Dijkstra(source);
+            }
+        }
+    }
+
+    const VertexDictionary& Vertices() const {
+        return vertices_;
+    }
+
+    PathRange Path(VertexDictionary::Id from, VertexDictionary::Id to) const {
+        if (fallback_) {
+            return fallback_->Path(from, to);
+        }
+        return MatrixPath<Weight>(vertices_.size(), dist_matrix_, next_vertex_, from, to);
+    }
+
+    DistanceMatrixView<Weight> Result() const {
+        if (fallback_) {
+            return fallback_->Result();
+        }
+        return { vertices_, dist_matrix_, next_vertex_ };
+    }
+
+    void PrintDistances(const std::string& file_name) const {
+        PrintDistanceMatrix<Weight>("output/" + file_name, Result());
+    }
+
+    void SaveResultMatrix(const std::string& file_name) const {
+        WriteResultMatrix<Weight>("output/" + file_name, Result());
+    }
+
+private:
+    DenseOptions options_;
+    VertexDictionary vertices_;
+    Adjacency graph_;
+    std::vector<double> potential_;
+    std::vector<Weight> dist_matrix_;
+    std::vector<int32_t> next_vertex_;
+    std::unique_ptr<DenseFloydWarshall<Weight>> fallback_;
+
+    void InitEdges(EdgeList graph) {
+        FW_PHASE(Phase::InitEdges);
+        vertices_ = std::move(graph.vertices);
+        graph_ = MakeAdjacency<Weight>(graph.Edges(), vertices_.size());
+    }
+
+    // Returns false if a negative cycle was found and the policy asks for the
+    // pairs through it to be marked; throws NegativeCycleException under
+    // NegativeCyclePolicy::Fail.
+    bool ComputePotentials() {
+        std::vector<uint32_t> cycle;
+        if (BellmanFordPotentials(graph_, potential_, cycle)) {
+            return true;
+        }
+        if (options_.negative_cycles == NegativeCyclePolicy::Mark) {
+            return false;
+        }
+        std::vector<std::string> names;
+        for (uint32_t v : cycle) {
+            names.emplace_back(vertices_.Name(v));
+        }
+        throw NegativeCycleException(std::move(names));
+    }
+
+    // Fills row `source`. The first hop towards v is inherited from the
+    // vertex v was reached through, so next_vertex_ means the same as in
+    // the Floyd-Warshall engines.
+    void Dijkstra(std::size_t source) {
+        const std::size_t n = vertices_.size();
+        Weight* row = &dist_matrix_[source * n];
+        int32_t* next_row = options_.track_paths ? &next_vertex_[source * n] : nullptr;
+        ReweightedDijkstra(graph_, potential_, 1.0, source,
+            [row](uint32_t u, double dist) {
+                row[u] = static_cast<Weight>(dist);
+            },
+            [next_row, source](uint32_t u, uint32_t v) {
+                if (next_row) {
+                    next_row[v] = u == source ? static_cast<int32_t>(v) : next_row[u];
+                }
+            });
+    }
+
+    void SolveWithFallback() {
+        EdgeList graph;
+        graph.vertices.Reserve(vertices_.size());
+        for (std::size_t v = 0; v < vertices_.size(); ++v) {
+            graph.vertices.InternView(vertices_.Name(v));
+        }
+        graph.edges.reserve(graph_.targets.size());
+        for (std::size_t u = 0; u < vertices_.size(); ++u) {
+            for (uint32_t e = graph_.first_edge[u]; e < graph_.first_edge[u + 1]; ++e) {
+                graph.edges.push_back({ static_cast<uint32_t>(u), graph_.targets[e], graph_.weights[e] });
+            }
+        }
+        fallback_ = std::make_unique<DenseFloydWarshall<Weight>>(std::move(graph), options_);
+        fallback_->GenerateDistanceMatrix();
+    }
+};
+
+// Picks Johnson over the vectorised Floyd-Warshall kernels. Johnson pays a
+// heap operation per scanned edge where Floyd-Warshall pays one vectorised
+// matrix cell per pivot, so Johnson wins below some E = V^2 / c. The factor
+// c = 256 is a heuristic estimate of that cost ratio, not a measured value;
+// it can be checked on a given machine with e.g.
+//     benchmark --engines=tiled,johnson --vertices=1024,2048 --densities=0.001,0.004,0.016
+// by looking for the density at which the two solve times cross.
+inline bool PreferJohnson(const EdgeList& graph) {
+    const double vertices = static_cast<double>(graph.vertices.size());
+    const double edges = static_cast<double>(graph.Edges().size());
+    return edges * 256 < vertices * vertices;
+}
@@ -1,166 +1,424 @@
 #include <algorithm>
-#include <chrono>
-#include <cmath>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <map>
-#include <numeric>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <exception>
 
-const double DOUBLE_MAX = std::numeric_limits<double>::max();
+#include "command_line.h"
+#include "dense_floyd_warshall.h"
+#include "fixed_floyd_warshall.h"
+#include "floyd_warshall.h"
+#include "instrumentation.h"
+#include "johnson.h"
+#include "out_of_core_floyd_warshall.h"
+#include "query_server.h"
+#include "source_shortest_paths.h"
+#include "work_stealing_pool.h"
 
-class CycleDetectedException : public std::exception {
-public:
-    const char* what() const noexcept override {
-        return "Cycle detected in the graph!";
-    }
+void PrintUsage() {
+    std::cerr << "Usage: <FileNameToLoad> <FileNameToSave> [options]\n"
+              << "  --engine=map|dense|tiled|johnson|auto|gpu|external|components\n"
+              << "  --tile=N\n"
+              << "  --simd=auto|scalar|avx2|avx512\n"
+              << "  --threads=N\n"
+              << "  --weight=auto|int32|float|double\n"
+              << "  --distances-only\n"
+              << "  --negative-cycles=fail|mark\n"
+              << "  --binary-output\n"
+              << "  --scratch=FILE\n"
+              << "  --sources=NAME,... --targets=NAME,... --top=K to print only part of the result\n"
+              << "Or: <FileNameToLoad> --serve [options] to answer queries on stdin\n"
+              << "Or: --batch=<Manifest> [options] to solve every \"<FileNameToLoad> <FileNameToSave>\" line of it"
+              << std::endl;
+}
+
+struct Options {
+    std::string input;
+    std::string output;
+    std::string engine = "map";
+    DenseOptions dense;
+    WeightType weight = WeightType::Auto;
+    bool binary_output = false;
+    // Tile file of the external engine, output/<FileNameToSave>.tiles if empty.
+    std::string scratch;
+    bool serve = false;
+    std::string batch;
+    // --sources, --targets and --top: print only these rows and columns, or
+    // the `top` nearest targets of each source.
+    bool query = false;
+    std::vector<std::string> sources;
+    std::vector<std::string> targets;
+    std::size_t top = 0;
 };
 
-class FloydWarshall {
-public:
-    FloydWarshall(const std::string& file_name) {
-        InitEdges("input/" + file_name);
-        InitDistanceMatrix();
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0) {
+            options.engine = arg.substr(9);
+        }
+        else if (arg.rfind("--tile=", 0) == 0) {
+            if (!ParseCount(arg.substr(7), options.dense.tile_size)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--threads=", 0) == 0) {
+            if (!ParseCount(arg.substr(10), options.dense.threads)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--simd=", 0) == 0) {
+            if (!ParseSimdLevel(arg.substr(7), options.dense.simd)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--weight=", 0) == 0) {
+            if (!ParseWeightType(arg.substr(9), options.weight)) {
+                return false;
+            }
+        }
+        else if (arg == "--negative-cycles=fail") {
+            options.dense.negative_cycles = NegativeCyclePolicy::Fail;
+        }
+        else if (arg == "--negative-cycles=mark") {
+            options.dense.negative_cycles = NegativeCyclePolicy::Mark;
+        }
+        else if (arg == "--distances-only") {
+            options.dense.track_paths = false;
+        }
+        else if (arg == "--binary-output") {
+            options.binary_output = true;
+        }
+        else if (arg.rfind("--scratch=", 0) == 0) {
+            options.scratch = arg.substr(10);
+            if (options.scratch.empty()) {
+                return false;
+            }
+        }
+        else if (arg == "--serve") {
+            options.serve = true;
+        }
+        else if (arg.rfind("--batch=", 0) == 0) {
+            options.batch = arg.substr(8);
+            if (options.batch.empty()) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--sources=", 0) == 0) {
+            options.query = true;
+            if (!ParseNameList(arg.substr(10), options.sources)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--targets=", 0) == 0) {
+            options.query = true;
+            if (!ParseNameList(arg.substr(10), options.targets)) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--top=", 0) == 0) {
+            options.query = true;
+            if (!ParseCount(arg.substr(6), options.top) || options.top == 0) {
+                return false;
+            }
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            return false;
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (options.engine == "tiled" || options.engine == "auto") {
+        options.dense.kernel = DenseKernel::Blocked;
+    }
+    else if (options.engine == "gpu") {
+        options.dense.kernel = DenseKernel::Gpu;
+    }
+    else if (options.engine == "components") {
+        options.dense.kernel = DenseKernel::Components;
+    }
+    else if (options.engine != "map" && options.engine != "dense" && options.engine != "johnson"
+             && options.engine != "external") {
+        return false;
+    }
+    // The external engine only writes its result in the binary format.
+    if (options.engine == "external" && (!options.binary_output || options.serve)) {
+        return false;
+    }
+    if (options.engine == "map" && options.binary_output) {
+        return false;
+    }
+    // Queries print text lines for a single graph.
+    if (options.query
+        && (options.binary_output || options.serve || !options.batch.empty() || options.engine == "map"
+            || options.engine == "external")) {
+        return false;
+    }
+    if (!options.batch.empty()) {
+        // Each entry gets its own scratch file next to its output.
+        return !options.serve && positional.empty() && options.scratch.empty();
+    }
+    if (options.serve) {
+        if (options.engine == "map" || options.engine == "johnson" || positional.size() != 1) {
+            return false;
+        }
+        options.input = positional[0];
+        return true;
+    }
+    if (positional.size() != 2) {
+        return false;
     }
+    options.input = positional[0];
+    options.output = positional[1];
+    return true;
+}
 
-    void GenerateDistanceMatrix() {
-        for_each_vertex([this](const std::string& k) {
-            for_each_vertex_pair([this, k](const std::string& i, const std::string& j) {
-                double i_k = dist_matrix_[{i, k}];
-                double k_j = dist_matrix_[{k, j}];
-                double i_j = dist_matrix_[{i, j}];
+template<typename Solver>
+void Solve(Solver& FW, const Options& options) {
+    FW.GenerateDistanceMatrix();
+    FW.PrintDistances(options.output);
+}
 
-                if (i_k < DOUBLE_MAX && k_j < DOUBLE_MAX && i_k + k_j < i_j) {
-                    dist_matrix_[{i, j}] = i_k + k_j;
-                    next_vertex_[{i, j}] = next_vertex_[{i, k}];
-                }
-            });
-        });
-    }
+// A query with at most V / SOURCE_QUERY_RATIO sources (or targets) is
+// answered by SourceShortestPaths from those roots alone; for more than that
+// the engine's all-pairs solve is the faster way to the same lines.
+const std::size_t SOURCE_QUERY_RATIO = 16;
 
-    void PrintDistances(const std::string& file_name) {
-        std::ofstream file_out("output/" + file_name);
-        for_each_vertex_pair([this, &file_out](const std::string& lhs, const std::string& rhs) {
-            double dist = dist_matrix_[{lhs, rhs}];
-            if (lhs != rhs) {
-                file_out << "from: " << lhs << " to: " << rhs;
-                if (dist == DOUBLE_MAX) {
-                    file_out << " - INF\n";
-                }
-                else {
-                    file_out << " - " << dist << " via path: " << GetPath(lhs, rhs) << "\n";
-                }
+DistanceQuery ResolveQuery(const VertexDictionary& vertices, const Options& options) {
+    DistanceQuery query;
+    query.top = options.top;
+    for (auto [names, ids] : { std::pair(&options.sources, &query.sources),
+                               std::pair(&options.targets, &query.targets) }) {
+        for (const std::string& name : *names) {
+            const VertexDictionary::Id id = vertices.Find(name);
+            if (id == VertexDictionary::NPOS) {
+                throw std::runtime_error("Unknown vertex: " + name);
             }
-        });
-        file_out.close();
+            ids->push_back(id);
+        }
     }
+    return query;
+}
 
-private:
-    std::map<std::pair<std::string, std::string>, double> dist_matrix_;
-    std::map<std::pair<std::string, std::string>, std::string> next_vertex_;
-    std::vector<std::string> vertices_;
+template<typename Weight>
+void SolveQuery(EdgeList graph, const DistanceQuery& query, const Options& options) {
+    using Direction = typename SourceShortestPaths<Weight>::Direction;
+    const bool from_sources =
+        !query.sources.empty() && (query.targets.empty() || query.sources.size() <= query.targets.size());
+    SourceShortestPaths<Weight> paths(std::move(graph), options.dense);
+    paths.Solve(from_sources ? query.sources : query.targets,
+                from_sources ? Direction::FromSources : Direction::ToTargets);
+    paths.PrintDistances(options.output, query);
+}
 
-    void InitDistanceMatrix() {
-        for_each_vertex_pair([this](const std::string& lhs, const std::string& rhs) {
-            if (lhs == rhs) {
-                dist_matrix_[{lhs, lhs}] = 0;
-            }
-            else if (!dist_matrix_.count({ lhs, rhs })) {
-                dist_matrix_[{lhs, rhs}] = DOUBLE_MAX;
-            }
-        });
+template<template<typename> class Engine, typename Weight>
+void SolveDenseAs(EdgeList graph, const Options& options, const DistanceQuery& query) {
+    Engine<Weight> FW(std::move(graph), options.dense);
+    if (options.binary_output) {
+        FW.GenerateDistanceMatrix();
+        FW.SaveResultMatrix(options.output);
+    }
+    else if (options.query) {
+        FW.GenerateDistanceMatrix();
+        PrintDistanceQuery<Weight>("output/" + options.output, FW.Result(), query);
     }
+    else {
+        Solve(FW, options);
+    }
+}
 
-    void InitEdges(const std::string& file_name) {
-        std::ifstream input_file(file_name);
-        std::string lhs, rhs;
-        double w;
+void SolveGraph(EdgeList graph, const Options& options) {
+    const WeightType weight = options.weight == WeightType::Auto ? NarrowestWeightType(graph) : options.weight;
 
-        while (input_file >> lhs >> rhs >> w) {
-            dist_matrix_[{lhs, rhs}] = w;
-            next_vertex_[{lhs, rhs}] = rhs;
-            if (std::find(vertices_.begin(), vertices_.end(), lhs) == vertices_.end()) {
-                vertices_.push_back(lhs);
-            }
-            if (std::find(vertices_.begin(), vertices_.end(), rhs) == vertices_.end()) {
-                vertices_.push_back(rhs);
+    const bool johnson = options.engine == "johnson" || (options.engine == "auto" && PreferJohnson(graph));
+
+    DistanceQuery query;
+    std::size_t roots = graph.vertices.size();
+    if (options.query) {
+        query = ResolveQuery(graph.vertices, options);
+        for (const auto* ids : { &query.sources, &query.targets }) {
+            if (!ids->empty()) {
+                roots = std::min(roots, ids->size());
             }
         }
-
-        input_file.close();
     }
 
-    template<typename Func>
-    void for_each_vertex_pair(Func func) const {
-        for (const auto& lhs : vertices_) {
-            for (const auto& rhs : vertices_) {
-                func(lhs, rhs);
-            }
+    WithWeightType(weight, [&](auto type) {
+        using Weight = typename decltype(type)::type;
+        if (options.serve) {
+            QueryServer<Weight> server(std::move(graph), options.dense);
+            server.Run(std::cin, std::cout);
         }
+        else if (options.query && roots * SOURCE_QUERY_RATIO <= graph.vertices.size()) {
+            SolveQuery<Weight>(std::move(graph), query, options);
+        }
+        else if (graph.vertices.size() <= FIXED_MAX_VERTICES
+                 && (options.engine == "dense" || options.engine == "auto")) {
+            SolveDenseAs<SmallFloydWarshall, Weight>(std::move(graph), options, query);
+        }
+        else if (johnson) {
+            SolveDenseAs<Johnson, Weight>(std::move(graph), options, query);
+        }
+        else if (options.engine == "external") {
+            const std::string scratch = options.scratch.empty() ? "output/" + options.output + ".tiles" : options.scratch;
+            OutOfCoreFloydWarshall<Weight> FW(std::move(graph), scratch, options.dense);
+            FW.GenerateDistanceMatrix();
+            FW.SaveResultMatrix(options.output);
+        }
+        else {
+            SolveDenseAs<DenseFloydWarshall, Weight>(std::move(graph), options, query);
+        }
+    });
+}
+
+void SolveDense(const Options& options) {
+    SolveGraph(LoadEdgeList("input/" + options.input, options.dense.threads), options);
+}
+
+struct BatchJob {
+    std::string input;
+    std::string output;
+};
+
+// Graphs at least this large are worth splitting over the whole pool; the
+// engines' parallel kernels scale well from here on, while below it one
+// thread per graph wins.
+const std::size_t BATCH_SPLIT_VERTICES = 1024;
+
+std::vector<BatchJob> ReadManifest(const std::string& file_name) {
+    std::ifstream file(file_name);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + file_name);
     }
 
-    template<typename Func>
-    void for_each_vertex(Func func) const {
-        for (const auto& v : vertices_) {
-            func(v);
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (std::size_t number = 1; std::getline(file, line); ++number) {
+        std::istringstream fields(line);
+        BatchJob job;
+        std::string extra;
+        if (!(fields >> job.input)) {
+            continue;
+        }
+        if (!(fields >> job.output) || fields >> extra) {
+            throw std::runtime_error(file_name + ":" + std::to_string(number) + ": expected <input> <output>");
         }
+        jobs.push_back(std::move(job));
     }
+    return jobs;
+}
 
-    std::string GetPath(const std::string& start, const std::string& end) const {
-        if (dist_matrix_.at({ start, end }) == DOUBLE_MAX) {
-            return "No path";
-        }
+// Solves every manifest entry on one work-stealing pool, largest files
+// first so that the long jobs start early and the small ones fill the gaps.
+// Each graph is solved single-threaded, except that graphs of at least
+// BATCH_SPLIT_VERTICES vertices are set aside and solved afterwards one at
+// a time with every thread. A failing entry is reported and skipped.
+// Returns whether all entries were solved.
+bool RunBatch(const Options& options) {
+    std::vector<BatchJob> jobs = ReadManifest(options.batch);
+    std::vector<uintmax_t> sizes;
+    for (const BatchJob& job : jobs) {
+        std::error_code error;
+        const uintmax_t size = std::filesystem::file_size("input/" + job.input, error);
+        sizes.push_back(error ? 0 : size);
+    }
+    std::vector<std::size_t> order(jobs.size());
+    for (std::size_t j = 0; j < order.size(); ++j) {
+        order[j] = j;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sizes](std::size_t lhs, std::size_t rhs) {
+        return sizes[lhs] > sizes[rhs];
+    });
 
-        std::string path = start;
-        std::string current = start;
+    WorkStealingPool pool(options.dense.threads);
+    std::mutex mutex;
+    std::size_t failures = 0;
+    std::vector<std::pair<std::size_t, EdgeList>> large;
+    auto report_failure = [&](const BatchJob& job, const char* what) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cerr << job.input << ": " << what << std::endl;
+        ++failures;
+    };
 
-        while (current != end) {
-            current = next_vertex_.at({ current, end });
-            if (current == end) {
-                path += "-" + current;
-                break;
+    for (std::size_t j : order) {
+        pool.Submit([&, j] {
+            const BatchJob& job = jobs[j];
+            Options single = options;
+            single.input = job.input;
+            single.output = job.output;
+            single.dense.threads = 1;
+            try {
+                if (options.engine == "map") {
+                    FloydWarshall FW(job.input);
+                    Solve(FW, single);
+                    return;
+                }
+                EdgeList graph = LoadEdgeList("input/" + job.input, 1);
+                if (pool.size() > 1 && graph.vertices.size() >= BATCH_SPLIT_VERTICES) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    large.emplace_back(j, std::move(graph));
+                    return;
+                }
+                SolveGraph(std::move(graph), single);
             }
-            if (path.find(current) != std::string::npos) {
-                throw CycleDetectedException();
+            catch (const std::exception& e) {
+                report_failure(job, e.what());
             }
-            path += "-" + current;
-        }
-
-        return path;
+        });
     }
-};
-
-void TestFile(std::ofstream& out, const std::string& file_name) {
-    auto t_start = std::chrono::high_resolution_clock::now();
-    FloydWarshall FW(file_name);
-    FW.GenerateDistanceMatrix();
-    auto t_stop = std::chrono::high_resolution_clock::now();
-    auto t_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_stop - t_start);
-    out << "Time duration: " << t_duration.count() / 1000.0 << " ms\n";
-}
+    pool.Wait();
 
-void RunTimeTest() {
-    std::ofstream log_file("log.txt");
-
-    TestFile(log_file, "test1.txt");
-    TestFile(log_file, "test2.txt");
-    TestFile(log_file, "test3.txt");
+    for (auto& [j, graph] : large) {
+        Options single = options;
+        single.input = jobs[j].input;
+        single.output = jobs[j].output;
+        try {
+            SolveGraph(std::move(graph), single);
+        }
+        catch (const std::exception& e) {
+            report_failure(jobs[j], e.what());
+        }
+    }
 
-    log_file.close();
+    std::cout << "Solved " << jobs.size() - failures << " of " << jobs.size() << " graphs\n";
+    return failures == 0;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: <FileNameToLoad> <FileNameToSave>" << std::endl;
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
         return 1;
     }
 
+    if (options.engine == "gpu" && !GpuAvailable()) {
+        std::cerr << "No CUDA device available, using the tiled CPU kernel" << std::endl;
+    }
+
     try {
-        FloydWarshall FW(argv[1]);
-        FW.GenerateDistanceMatrix();
-        FW.PrintDistances(argv[2]);
+        FW_REPORT_RUN(std::cerr);
+        if (!options.batch.empty()) {
+            if (!RunBatch(options)) {
+                return 1;
+            }
+        }
+        else if (options.engine == "map") {
+            FloydWarshall FW(options.input);
+            Solve(FW, options);
+        }
+        else {
+            SolveDense(options);
+        }
     }
     catch (const CycleDetectedException& e) {
         std::cerr << e.what() << std::endl;
@@ -171,7 +429,8 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    RunTimeTest();
-    std::cout << "Success!\n";
+    if (!options.serve) {
+        std::cout << "Success!\n";
+    }
     return 0;
 }
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FW_HAVE_MMAP 1
+#else
+#include <fstream>
+#include <iterator>
+#include <vector>
+#endif
+
+// Read-only view of a whole file. Uses mmap where available and falls back
+// to reading the file into memory elsewhere. `access` is passed on to the
+// kernel as a readahead hint.
+class MappedFile {
+public:
+    enum class Access {
+        Sequential,
+        Random,
+    };
+
+    explicit MappedFile(const std::string& file_name, Access access = Access::Sequential) {
+#if defined(FW_HAVE_MMAP)
+        const int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + file_name);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + file_name);
+        }
+        size_ = static_cast<std::size_t>(info.st_size);
+        if (size_ > 0) {
+            void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map " + file_name);
+            }
+            data_ = static_cast<const char*>(address);
+            ::madvise(address, size_, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        }
+        ::close(fd);
+#else
+        (void)access;
+        std::ifstream input_file(file_name, std::ios::binary);
+        if (!input_file) {
+            throw std::runtime_error("Cannot open " + file_name);
+        }
+        contents_.assign(std::istreambuf_iterator<char>(input_file), std::istreambuf_iterator<char>());
+        data_ = contents_.data();
+        size_ = contents_.size();
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#if defined(FW_HAVE_MMAP)
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+    }
+
+    std::string_view data() const {
+        return { data_, size_ };
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+#if !defined(FW_HAVE_MMAP)
+    std::string contents_;
+#endif
+};
+
+// Writable scratch space of a fixed size backed by a file, so matrices larger
+// than RAM are paged to and from it by the kernel instead of the swap. The
+// file is created (or truncated) on construction and removed on
+// destruction. Without mmap the space lives in memory. Prefetch and Evict
+// are hints and may be no-ops.
+class ScratchFile {
+public:
+    ScratchFile(const std::string& file_name, std::size_t size)
+        : file_name_(file_name), size_(size) {
+#if defined(FW_HAVE_MMAP)
+        const int fd = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create " + file_name);
+        }
+        if (size_ > 0) {
+            void* address = MAP_FAILED;
+            if (::ftruncate(fd, static_cast<off_t>(size_)) == 0) {
+                address = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                std::remove(file_name.c_str());
+                throw std::runtime_error("Cannot map " + file_name);
+            }
+            data_ = static_cast<char*>(address);
+        }
+        ::close(fd);
+#else
+        contents_.resize(size_);
+        data_ = contents_.data();
+#endif
+    }
+
+    ScratchFile(const ScratchFile&) = delete;
+    ScratchFile& operator=(const ScratchFile&) = delete;
+
+    ~ScratchFile() {
+#if defined(FW_HAVE_MMAP)
+        if (data_) {
+            ::munmap(data_, size_);
+        }
+        std::remove(file_name_.c_str());
+#endif
+    }
+
+    char* data() const {
+        return data_;
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+    // Starts reading [offset, offset + length) in ahead of use.
+    void Prefetch(std::size_t offset, std::size_t length) const {
+#if defined(FW_HAVE_MMAP)
+        Advise(offset, length, [](char* address, std::size_t bytes) {
+            ::madvise(address, bytes, MADV_WILLNEED);
+        });
+#else
+        (void)offset;
+        (void)length;
+#endif
+    }
+
+    // Starts writing the range back and drops it from the resident set; the
+    // pages stay in the page cache until the kernel needs the memory.
+    void Evict(std::size_t offset, std::size_t length) const {
+#if defined(FW_HAVE_MMAP)
+        Advise(offset, length, [](char* address, std::size_t bytes) {
+            ::msync(address, bytes, MS_ASYNC);
+            ::madvise(address, bytes, MADV_DONTNEED);
+        });
+#else
+        (void)offset;
+        (void)length;
+#endif
+    }
+
+private:
+    std::string file_name_;
+    char* data_ = nullptr;
+    std::size_t size_ = 0;
+#if !defined(FW_HAVE_MMAP)
+    std::vector<char> contents_;
+#else
+    // Widens the range to whole pages, as madvise and msync require.
+    template<typename Func>
+    void Advise(std::size_t offset, std::size_t length, Func&& func) const {
+        if (!data_ || offset >= size_) {
+            return;
+        }
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const std::size_t begin = offset / page * page;
+        const std::size_t end = std::min(size_, offset + length);
+        func(data_ + begin, end - begin);
+    }
+#endif
+};
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dense_floyd_warshall.h"
+#include "distance_writer.h"
+#include "edge_list.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
+#include "relax_kernels.h"
+#include "result_matrix.h"
+#include "thread_pool.h"
+#include "vertex_dictionary.h"
+#include "weight_traits.h"
+
+// Blocked Floyd-Warshall for matrices larger than RAM. The distance and
+// successor matrices live as B x B tiles in a shared file mapping, tile
+// (I, J) of the T x T grid stored contiguously at index I * T + J, so a tile
+// row is one contiguous range of the file. For every pivot block b the
+// three phases of the in-memory blocked kernel run tile by tile, and phase
+// three walks the grid one tile row at a time: each off-pivot tile is read
+// and written once per pivot block, the next tile row is prefetched while
+// the current one is relaxed, and a finished row is written back and
+// dropped from the resident set. Memory in use stays near the pivot tile
+// row plus two tile rows, about 3 * B * V cells.
+//
+// Results are streamed tile row by tile row into the binary result format.
+// Uses the tile_size (rounded up to a multiple of 32, 0 picks
+// DEFAULT_TILE), simd, threads, track_paths and negative_cycles fields of
+// DenseOptions.
+template<typename Weight = double>
+class OutOfCoreFloydWarshall {
+public:
+    using Traits = WeightTraits<Weight>;
+
+    static constexpr std::size_t DEFAULT_TILE = 512;
+
+    OutOfCoreFloydWarshall(EdgeList graph, const std::string& scratch_file, const DenseOptions& options = {})
+        : options_(options), relax_row_(SelectRelaxRow<Weight>(options.simd, options.track_paths)) {
+        vertices_ = std::move(graph.vertices);
+        const std::size_t n = vertices_.size();
+        // Whole tiles of at least 4 KiB keep every tile page-aligned.
+        tile_ = (std::max<std::size_t>(options_.tile_size ? options_.tile_size : DEFAULT_TILE, 1) + 31) / 32 * 32;
+        tiles_ = (n + tile_ - 1) / tile_;
+        tile_cells_ = tile_ * tile_;
+        const std::size_t cells = tiles_ * tiles_ * tile_cells_;
+        dist_bytes_ = cells * sizeof(Weight);
+        scratch_ = std::make_unique<ScratchFile>(
+            scratch_file, dist_bytes_ + (options_.track_paths ? cells * sizeof(int32_t) : 0));
+        InitDistanceMatrix(graph);
+    }
+
+    void GenerateDistanceMatrix() {
+        FW_PHASE(Phase::GenerateDistanceMatrix);
+        if (options_.threads != 1 && !pool_) {
+            pool_ = std::make_unique<ThreadPool>(options_.threads);
+        }
+
+        for (std::size_t b = 0; b < tiles_; ++b) {
+            RelaxTile(b, b, b, b, 0, tile_);
+            CheckNegativeCycle(b);
+
+            ParallelFor(2 * tiles_, [&](std::size_t task) {
+                const std::size_t t = task / 2;
+                if (t == b) {
+                    return;
+                }
+                if (task % 2 == 0) {
+                    RelaxTile(b, t, b, b, 0, tile_);
+                }
+                else {
+                    RelaxTile(t, b, t, b, 0, tile_);
+                }
+            });
+
+            for (std::size_t i = 0; i < tiles_; ++i) {
+                if (i == b) {
+                    continue;
+                }
+                if (i + 1 < tiles_) {
+                    PrefetchTileRow(i + 1 == b ? i + 2 : i + 1);
+                }
+                ParallelFor(tiles_, [&](std::size_t j) {
+                    if (j != b) {
+                        RelaxTile(i, j, i, b, 0, tile_);
+                    }
+                });
+                EvictTileRow(i);
+            }
+        }
+
+        MarkUnboundedPairs();
+        // As in DenseFloydWarshall, out-of-order pivots can close successor
+        // loops on zero-weight cycles; they are repaired in place.
+        if (options_.track_paths) {
+            RepairSuccessors();
+        }
+        graph_edges_ = EdgeList();
+    }
+
+    const VertexDictionary& Vertices() const {
+        return vertices_;
+    }
+
+    Weight Distance(VertexDictionary::Id from, VertexDictionary::Id to) const {
+        return Dist(from, to);
+    }
+
+    // Streams the matrices into the binary format of result_matrix.h.
+    void SaveResultMatrix(const std::string& file_name) const {
+        WriteResultMatrixStreamed<Weight>(
+            "output/" + file_name, vertices_, options_.track_paths,
+            [this](DistanceWriter& out) {
+                WriteRows(out, reinterpret_cast<const char*>(DistTile(0, 0)), sizeof(Weight), 0);
+            },
+            [this](DistanceWriter& out) {
+                WriteRows(out, reinterpret_cast<const char*>(NextTile(0, 0)), sizeof(int32_t), dist_bytes_);
+            });
+    }
+
+private:
+    DenseOptions options_;
+    RelaxRowFn<Weight> relax_row_;
+    std::unique_ptr<ThreadPool> pool_;
+    VertexDictionary vertices_;
+    // The edges are needed again only if successors must be repaired.
+    EdgeList graph_edges_;
+    std::size_t tile_ = 0;
+    std::size_t tiles_ = 0;
+    std::size_t tile_cells_ = 0;
+    std::size_t dist_bytes_ = 0;
+    std::unique_ptr<ScratchFile> scratch_;
+
+    Weight* DistTile(std::size_t i, std::size_t j) const {
+        return reinterpret_cast<Weight*>(scratch_->data()) + (i * tiles_ + j) * tile_cells_;
+    }
+
+    int32_t* NextTile(std::size_t i, std::size_t j) const {
+        if (!options_.track_paths) {
+            return nullptr;
+        }
+        return reinterpret_cast<int32_t*>(scratch_->data() + dist_bytes_) + (i * tiles_ + j) * tile_cells_;
+    }
+
+    std::size_t Cell(std::size_t i, std::size_t j) const {
+        return (i % tile_) * tile_ + j % tile_;
+    }
+
+    Weight& Dist(std::size_t i, std::size_t j) const {
+        return DistTile(i / tile_, j / tile_)[Cell(i, j)];
+    }
+
+    int32_t& Next(std::size_t i, std::size_t j) const {
+        return NextTile(i / tile_, j / tile_)[Cell(i, j)];
+    }
+
+    // Padding cells beyond V stay unreachable, so they never relax anything.
+    // The matrix is built and evicted one tile row at a time, each pass
+    // picking that row's edges out of the edge list, so initialising never
+    // needs the whole file resident.
+    void InitDistanceMatrix(EdgeList& graph) {
+        FW_PHASE(Phase::InitDistanceMatrix);
+        const std::size_t n = vertices_.size();
+        for (std::size_t i = 0; i < tiles_; ++i) {
+            ParallelFor(tiles_, [&](std::size_t j) {
+                std::fill_n(DistTile(i, j), tile_cells_, Traits::Infinity());
+                if (options_.track_paths) {
+                    std::fill_n(NextTile(i, j), tile_cells_, -1);
+                }
+            });
+            for (const Edge& edge : graph.Edges()) {
+                if (edge.from / tile_ != i) {
+                    continue;
+                }
+                Dist(edge.from, edge.to) = static_cast<Weight>(edge.weight);
+                if (options_.track_paths) {
+                    Next(edge.from, edge.to) = static_cast<int32_t>(edge.to);
+                }
+            }
+            for (std::size_t v = i * tile_; v < std::min(n, (i + 1) * tile_); ++v) {
+                Dist(v, v) = 0;
+            }
+            EvictTileRow(i);
+        }
+        if (&graph != &graph_edges_) {
+            graph_edges_ = std::move(graph);
+        }
+    }
+
+    // Relaxes tile (i, j) through pivots [k_begin, k_end) of block kb: the
+    // pivot columns and first hops come from tile (via_i, kb), the pivot
+    // rows from tile (kb, j). via_i is i except for the pivot row tiles of
+    // phase two, which read the pivot tile instead.
+    void RelaxTile(std::size_t i, std::size_t j, std::size_t via_i, std::size_t kb, std::size_t k_begin,
+                   std::size_t k_end) {
+        Weight* dist = DistTile(i, j);
+        int32_t* next = NextTile(i, j);
+        const Weight* left = DistTile(via_i, kb);
+        const int32_t* left_next = NextTile(via_i, kb);
+        const Weight* right = DistTile(kb, j);
+        for (std::size_t k = k_begin; k < k_end; ++k) {
+            const Weight* row_k = right + k * tile_;
+            for (std::size_t r = 0; r < tile_; ++r) {
+                const Weight i_k = left[r * tile_ + k];
+                if (i_k == Traits::Infinity()) {
+                    continue;
+                }
+                int32_t* next_r = next ? next + r * tile_ : nullptr;
+                FW_COUNT(Counter::Relaxations, tile_);
+                relax_row_(dist + r * tile_, next_r, row_k, i_k, left_next ? left_next[r * tile_ + k] : -1, 0,
+                           tile_);
+            }
+        }
+    }
+
+    std::size_t TileRowBytes(std::size_t element_size) const {
+        return tiles_ * tile_cells_ * element_size;
+    }
+
+    void PrefetchTileRow(std::size_t i) const {
+        if (i >= tiles_) {
+            return;
+        }
+        scratch_->Prefetch(i * TileRowBytes(sizeof(Weight)), TileRowBytes(sizeof(Weight)));
+        if (options_.track_paths) {
+            scratch_->Prefetch(dist_bytes_ + i * TileRowBytes(sizeof(int32_t)), TileRowBytes(sizeof(int32_t)));
+        }
+    }
+
+    void EvictTileRow(std::size_t i) const {
+        scratch_->Evict(i * TileRowBytes(sizeof(Weight)), TileRowBytes(sizeof(Weight)));
+        if (options_.track_paths) {
+            scratch_->Evict(dist_bytes_ + i * TileRowBytes(sizeof(int32_t)), TileRowBytes(sizeof(int32_t)));
+        }
+    }
+
+    void EvictTileColumn(std::size_t j) const {
+        for (std::size_t i = 0; i < tiles_; ++i) {
+            const std::size_t tile = i * tiles_ + j;
+            scratch_->Evict(tile * tile_cells_ * sizeof(Weight), tile_cells_ * sizeof(Weight));
+            if (options_.track_paths) {
+                scratch_->Evict(dist_bytes_ + tile * tile_cells_ * sizeof(int32_t), tile_cells_ * sizeof(int32_t));
+            }
+        }
+    }
+
+    // Appends the V * V cells of one matrix in row-major order; `base` is
+    // the matrix's start in the file, whose tile rows are each prefetched
+    // ahead and evicted once written.
+    void WriteRows(DistanceWriter& out, const char* matrix, std::size_t element_size, std::size_t base) const {
+        const std::size_t n = vertices_.size();
+        const std::size_t row_bytes = TileRowBytes(element_size);
+        for (std::size_t i = 0; i < tiles_; ++i) {
+            scratch_->Prefetch(base + (i + 1) * row_bytes, row_bytes);
+            for (std::size_t r = 0; r < tile_ && i * tile_ + r < n; ++r) {
+                for (std::size_t j = 0; j < tiles_; ++j) {
+                    const char* row = matrix + ((i * tiles_ + j) * tile_cells_ + r * tile_) * element_size;
+                    out.Write(std::string_view(row, std::min(tile_, n - j * tile_) * element_size));
+                }
+            }
+            scratch_->Evict(base + i * row_bytes, row_bytes);
+        }
+    }
+
+    template<typename Func>
+    void ParallelFor(std::size_t count, Func&& func) {
+        if (pool_) {
+            pool_->ParallelFor(count, func);
+        }
+        else {
+            for (std::size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+        }
+    }
+
+    // A negative cycle through a vertex of block b shows up on the diagonal
+    // once the pivot tile is closed.
+    void CheckNegativeCycle(std::size_t b) const {
+        if (options_.negative_cycles != NegativeCyclePolicy::Fail) {
+            return;
+        }
+
+        const std::size_t n = vertices_.size();
+        for (std::size_t k = b * tile_; k < std::min(n, (b + 1) * tile_); ++k) {
+            if (Dist(k, k) >= 0) {
+                continue;
+            }
+            std::vector<bool> affected(n);
+            for (std::size_t v = 0; v < n; ++v) {
+                affected[v] = Dist(v, v) < 0;
+            }
+            if (options_.track_paths) {
+                std::size_t current = k;
+                for (std::size_t steps = 0; steps < n && Next(current, k) >= 0; ++steps) {
+                    current = static_cast<std::size_t>(Next(current, k));
+                    affected[current] = true;
+                    if (current == k) {
+                        break;
+                    }
+                }
+            }
+
+            std::vector<std::string> on_cycle;
+            for (std::size_t v = 0; v < n; ++v) {
+                if (affected[v]) {
+                    on_cycle.emplace_back(vertices_.Name(v));
+                }
+            }
+            throw NegativeCycleException(std::move(on_cycle));
+        }
+    }
+
+    // Same marking as DenseFloydWarshall::MarkUnboundedPairs, one tile row
+    // of the file at a time.
+    void MarkUnboundedPairs() {
+        const std::size_t n = vertices_.size();
+        std::vector<std::size_t> on_cycle;
+        for (std::size_t k = 0; k < n; ++k) {
+            if (Dist(k, k) < 0) {
+                on_cycle.push_back(k);
+            }
+        }
+        if (on_cycle.empty()) {
+            return;
+        }
+
+        const std::size_t words = (n + 63) / 64;
+        std::vector<uint64_t> reach_from(on_cycle.size() * words, 0);
+        for (std::size_t c = 0; c < on_cycle.size(); ++c) {
+            for (std::size_t j = 0; j < n; ++j) {
+                if (Dist(on_cycle[c], j) != Traits::Infinity()) {
+                    reach_from[c * words + j / 64] |= uint64_t(1) << (j % 64);
+                }
+            }
+        }
+        scratch_->Evict(0, scratch_->size());
+
+        std::vector<uint64_t> unbounded(words);
+        for (std::size_t i = 0; i < n; ++i) {
+            std::fill(unbounded.begin(), unbounded.end(), 0);
+            for (std::size_t c = 0; c < on_cycle.size(); ++c) {
+                if (Dist(i, on_cycle[c]) != Traits::Infinity()) {
+                    for (std::size_t w = 0; w < words; ++w) {
+                        unbounded[w] |= reach_from[c * words + w];
+                    }
+                }
+            }
+            for (std::size_t j = 0; j < n; ++j) {
+                if (unbounded[j / 64] >> (j % 64) & 1) {
+                    Dist(i, j) = Traits::NegativeInfinity();
+                }
+            }
+            if ((i + 1) % tile_ == 0 || i + 1 == n) {
+                EvictTileRow(i / tile_);
+            }
+        }
+    }
+
+    static constexpr char WALK_UNSEEN = 0;
+    static constexpr char WALK_OPEN = 1;
+    static constexpr char WALK_ARRIVES = 2;
+    static constexpr char WALK_LOOPS = 3;
+
+    // An edge into some vertex, from `from`.
+    struct InArc {
+        uint32_t from;
+        Weight weight;
+    };
+
+    static bool IsFinite(Weight value) {
+        return value != Traits::Infinity() && value != Traits::NegativeInfinity();
+    }
+
+    // As DenseFloydWarshall::NotLonger: ties of floating sums need slack.
+    static bool NotLonger(Weight through, Weight best) {
+        if constexpr (std::is_integral_v<Weight>) {
+            return through <= best;
+        }
+        else {
+            return through <= best + std::abs(best) * 64 * std::numeric_limits<Weight>::epsilon();
+        }
+    }
+
+    // Same repair as DenseFloydWarshall::RepairSuccessors, in place. Targets
+    // are taken in order, so the walks and the repairs stay within one tile
+    // column at a time and each column's tiles are evicted once its targets
+    // are done: one pass over the file in all.
+    void RepairSuccessors() {
+        const std::size_t n = vertices_.size();
+        std::vector<char> state(n);
+        std::vector<std::size_t> walk;
+        // Built on the first repair.
+        std::vector<std::vector<InArc>> in_arcs;
+        for (std::size_t j = 0; j < n; ++j) {
+            std::fill(state.begin(), state.end(), WALK_UNSEEN);
+            state[j] = WALK_ARRIVES;
+            bool loops = false;
+            for (std::size_t i = 0; i < n; ++i) {
+                walk.clear();
+                std::size_t current = i;
+                while (state[current] == WALK_UNSEEN && IsFinite(Dist(current, j))) {
+                    state[current] = WALK_OPEN;
+                    walk.push_back(current);
+                    current = static_cast<std::size_t>(Next(current, j));
+                }
+                const char end = state[current] == WALK_ARRIVES ? WALK_ARRIVES : WALK_LOOPS;
+                for (std::size_t v : walk) {
+                    state[v] = end;
+                }
+                loops = loops || (!walk.empty() && end == WALK_LOOPS);
+            }
+            if (loops) {
+                RepairColumn(j, state, in_arcs);
+            }
+            if ((j + 1) % tile_ == 0 || j + 1 == n) {
+                EvictTileColumn(j / tile_);
+            }
+        }
+    }
+
+    // Same as DenseFloydWarshall::RepairColumn, with the in-edges taken from
+    // the kept edge list: the last of several edges between a pair wins and
+    // self-loops are dropped, as in InitDistanceMatrix.
+    void RepairColumn(std::size_t j, std::vector<char>& state, std::vector<std::vector<InArc>>& in_arcs) {
+        const std::size_t n = vertices_.size();
+        if (in_arcs.empty()) {
+            in_arcs.resize(n);
+            for (const Edge& edge : graph_edges_.Edges()) {
+                if (edge.from != edge.to) {
+                    in_arcs[edge.to].push_back({ edge.from, static_cast<Weight>(edge.weight) });
+                }
+            }
+            for (auto& arcs : in_arcs) {
+                std::stable_sort(arcs.begin(), arcs.end(), [](const InArc& lhs, const InArc& rhs) {
+                    return lhs.from < rhs.from;
+                });
+                std::reverse(arcs.begin(), arcs.end());
+                arcs.erase(std::unique(arcs.begin(), arcs.end(), [](const InArc& lhs, const InArc& rhs) {
+                    return lhs.from == rhs.from;
+                }), arcs.end());
+            }
+        }
+
+        std::vector<uint32_t> arrived;
+        for (std::size_t v = 0; v < n; ++v) {
+            if (state[v] == WALK_ARRIVES && IsFinite(Dist(v, j))) {
+                arrived.push_back(static_cast<uint32_t>(v));
+            }
+        }
+        for (std::size_t a = 0; a < arrived.size(); ++a) {
+            const uint32_t to = arrived[a];
+            for (const InArc& arc : in_arcs[to]) {
+                if (state[arc.from] == WALK_LOOPS
+                    && NotLonger(Traits::Add(arc.weight, Dist(to, j)), Dist(arc.from, j))) {
+                    state[arc.from] = WALK_ARRIVES;
+                    Next(arc.from, j) = static_cast<int32_t>(to);
+                    arrived.push_back(arc.from);
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory_resource>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "path_range.h"
+#include "vertex_dictionary.h"
+
+// Bounded LRU cache of materialised paths for repeated (source, target)
+// queries: a hit is one hash lookup and a list splice. List nodes, hash
+// nodes and path buffers are carved from a pool owned by the cache, so an
+// eviction hands its blocks straight to the next miss instead of going
+// through the global heap, and destroying the cache frees them together.
+// Not synchronised; give each serving thread its own cache, and Clear() it
+// whenever the solver's successor matrix changes.
+class PathCache {
+public:
+    using Id = VertexDictionary::Id;
+
+    explicit PathCache(std::size_t capacity)
+        : capacity_(capacity) {
+        entries_.reserve(capacity);
+    }
+
+    // The containers point at pool_.
+    PathCache(const PathCache&) = delete;
+    PathCache& operator=(const PathCache&) = delete;
+
+    // Returns the cached path, calling fill() for a PathRange on a miss. The
+    // span stays valid until the entry is evicted by a later Get or Clear.
+    template<typename Fill>
+    std::span<const Id> Get(Id from, Id to, Fill&& fill) {
+        const uint64_t key = static_cast<uint64_t>(from) << 32 | to;
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            ++hits_;
+            order_.splice(order_.begin(), order_, it->second);
+            return it->second->path;
+        }
+
+        ++misses_;
+        if (capacity_ == 0) {
+            uncached_ = fill().ToVector();
+            return uncached_;
+        }
+        if (entries_.size() == capacity_) {
+            entries_.erase(order_.back().key);
+            order_.pop_back();
+        }
+        const PathRange path = fill();
+        order_.emplace_front(key, path.begin(), path.end());
+        entries_.emplace(key, order_.begin());
+        return order_.front().path;
+    }
+
+    void Clear() {
+        entries_.clear();
+        order_.clear();
+    }
+
+    std::size_t size() const {
+        return entries_.size();
+    }
+
+    std::size_t Hits() const {
+        return hits_;
+    }
+
+    std::size_t Misses() const {
+        return misses_;
+    }
+
+private:
+    struct Entry {
+        using allocator_type = std::pmr::polymorphic_allocator<Id>;
+
+        uint64_t key;
+        std::pmr::vector<Id> path;
+
+        Entry(uint64_t key, PathRange::Iterator begin, PathRange::Iterator end, const allocator_type& allocator)
+            : key(key), path(begin, end, allocator) {
+        }
+    };
+
+    std::size_t capacity_;
+    // Declared before the containers so it outlives them.
+    std::pmr::unsynchronized_pool_resource pool_;
+    std::pmr::list<Entry> order_{ &pool_ };
+    std::pmr::unordered_map<uint64_t, std::pmr::list<Entry>::iterator> entries_{ &pool_ };
+    std::vector<Id> uncached_;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+
+#include "floyd_warshall.h"
+#include "vertex_dictionary.h"
+
+// Lazy view of one shortest path: iterating walks the row-major successor
+// matrix, or a table of successor rows, from start towards end and yields
+// the vertex ids on the way, both ends included, without building anything.
+// A default-constructed range is empty and stands for "no path". A walk that
+// hits a missing or out-of-range successor, as a corrupt result file can
+// hold, or takes more than V steps throws CycleDetectedException.
+class PathRange {
+public:
+    using Id = VertexDictionary::Id;
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Id;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Id*;
+        using reference = Id;
+
+        Iterator() = default;
+
+        Id operator*() const {
+            return current_;
+        }
+
+        Iterator& operator++() {
+            if (current_ == range_->end_) {
+                current_ = VertexDictionary::NPOS;
+                steps_ = 0;
+                return *this;
+            }
+            const int32_t next = range_->Successor(current_);
+            if (next < 0 || static_cast<std::size_t>(next) >= range_->vertex_count_
+                || ++steps_ > range_->vertex_count_) {
+                throw CycleDetectedException();
+            }
+            current_ = static_cast<Id>(next);
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return current_ == other.current_ && steps_ == other.steps_;
+        }
+
+    private:
+        friend class PathRange;
+
+        const PathRange* range_ = nullptr;
+        Id current_ = VertexDictionary::NPOS;
+        std::size_t steps_ = 0;
+
+        Iterator(const PathRange* range, Id current, std::size_t steps)
+            : range_(range), current_(current), steps_(steps) {
+        }
+    };
+
+    PathRange() = default;
+
+    PathRange(std::span<const int32_t> next, std::size_t vertex_count, Id start, Id end)
+        : next_(next), vertex_count_(vertex_count), start_(start), end_(end) {
+    }
+
+    // Row v of the successor matrix at rows[v].
+    PathRange(std::span<const int32_t* const> rows, Id start, Id end)
+        : rows_(rows), vertex_count_(rows.size()), start_(start), end_(end) {
+    }
+
+    Iterator begin() const {
+        return empty() ? end() : Iterator(this, start_, 0);
+    }
+
+    Iterator end() const {
+        return Iterator(this, VertexDictionary::NPOS, 0);
+    }
+
+    bool empty() const {
+        return next_.empty() && rows_.empty();
+    }
+
+    std::vector<Id> ToVector() const {
+        std::vector<Id> path;
+        for (Id vertex : *this) {
+            path.push_back(vertex);
+        }
+        return path;
+    }
+
+private:
+    std::span<const int32_t> next_;
+    std::span<const int32_t* const> rows_;
+    std::size_t vertex_count_ = 0;
+    Id start_ = 0;
+    Id end_ = 0;
+
+    int32_t Successor(Id vertex) const {
+        return rows_.empty() ? next_[static_cast<std::size_t>(vertex) * vertex_count_ + end_] : rows_[vertex][end_];
+    }
+};
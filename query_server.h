@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "dense_floyd_warshall.h"
+#include "distance_writer.h"
+#include "edge_list.h"
+#include "path_cache.h"
+#include "path_range.h"
+#include "result_matrix.h"
+#include "thread_pool.h"
+
+// Keeps a solved graph resident and answers queries from it. Readers work on
+// an immutable snapshot of the matrices and never wait for an update to be
+// computed: edge updates are applied to a private solver, and the result is
+// published as a new snapshot with one std::atomic_store on a shared_ptr, so
+// a reader sees either the whole update or none of it. Those shared_ptr
+// atomics take a short internal lock in libstdc++, so picking up a snapshot
+// is not lock-free. Run() itself reads requests from one stream and handles
+// a commit between queries; readers only overlap a commit when Answer and
+// Apply are called from different threads. A snapshot is a list of shared
+// rows: a commit compares every row with the previous snapshot, in O(V^2),
+// but copies only the rows that changed. Each thread answering path queries
+// keeps a PathCache of the paths it walked on the current snapshot, dropped
+// once it sees a newer one. Vertex names are fixed at load time.
+//
+// Line protocol, one reply line per request line:
+//     dist <from> <to>          distance, INF or -INF
+//     path <from> <to>          distance and " via path: a-...-b", or INF/-INF
+//     batch <k>                 the next k lines (at most MAX_BATCH) are dist/path
+//                               queries, answered in parallel and replied to in
+//                               order
+//     set <from> <to> <weight>  queue an edge insert or weight change
+//     remove <from> <to>        queue an edge removal
+//     commit                    apply the queued changes, reply "published <version>"
+//     quit
+// Malformed requests get "error <reason>".
+template<typename Weight = double>
+class QueryServer {
+public:
+    using Traits = WeightTraits<Weight>;
+
+    // Row i of the distance matrix and, with paths, of the successor matrix.
+    struct Row {
+        std::vector<Weight> dist;
+        std::vector<int32_t> next;
+    };
+
+    struct Snapshot {
+        uint64_t version;
+        std::vector<std::shared_ptr<const Row>> rows;
+        // rows[v]->next.data() for every v; empty when paths are not tracked.
+        std::vector<const int32_t*> next_rows;
+    };
+
+    QueryServer(EdgeList graph, const DenseOptions& options = {})
+        : solver_(std::move(graph), options), pool_(options.threads) {
+        solver_.GenerateDistanceMatrix();
+        Publish();
+    }
+
+    std::shared_ptr<const Snapshot> Current() const {
+        return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+    }
+
+    // Safe to call from any number of threads, also while Apply runs.
+    std::string Answer(std::string_view request) const {
+        try {
+            return AnswerQuery(request);
+        }
+        catch (const std::exception& e) {
+            return std::string("error ") + e.what();
+        }
+    }
+
+    // Applies the updates and publishes the result; one writer at a time.
+    // If a lowered edge closes a negative cycle under the Fail policy, the
+    // updates before it are still published before the exception leaves.
+    uint64_t Apply(std::span<const EdgeUpdate> updates) {
+        std::lock_guard<std::mutex> lock(update_mutex_);
+        try {
+            solver_.UpdateEdges(updates);
+        }
+        catch (...) {
+            Publish();
+            throw;
+        }
+        return Publish();
+    }
+
+    void Run(std::istream& in, std::ostream& out) {
+        std::vector<EdgeUpdate> pending;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::size_t pos = 0;
+            const std::string_view command = NextToken(line, pos);
+            if (command.empty()) {
+                continue;
+            }
+            if (command == "quit") {
+                break;
+            }
+
+            try {
+                if (command == "batch") {
+                    std::size_t count = 0;
+                    const std::string_view count_token = NextToken(line, pos);
+                    const auto [ptr, ec] = std::from_chars(count_token.data(), count_token.data() + count_token.size(), count);
+                    if (ec != std::errc() || ptr != count_token.data() + count_token.size()) {
+                        throw std::invalid_argument("expected batch <count>");
+                    }
+                    if (count > MAX_BATCH) {
+                        throw std::invalid_argument("batch takes at most " + std::to_string(MAX_BATCH) + " requests");
+                    }
+                    std::vector<std::string> requests(count);
+                    for (auto& request : requests) {
+                        std::getline(in, request);
+                    }
+                    std::vector<std::string> replies(count);
+                    pool_.ParallelFor(count, [&](std::size_t q) {
+                        replies[q] = Answer(requests[q]);
+                    });
+                    for (const auto& reply : replies) {
+                        out << reply << '\n';
+                    }
+                }
+                else if (command == "set" || command == "remove") {
+                    const VertexDictionary::Id from = FindVertex(NextToken(line, pos));
+                    const VertexDictionary::Id to = FindVertex(NextToken(line, pos));
+                    double weight = std::numeric_limits<double>::infinity();
+                    if (from == VertexDictionary::NPOS || to == VertexDictionary::NPOS) {
+                        out << "error unknown vertex\n";
+                    }
+                    else if (command == "set" && !ParseWeight(NextToken(line, pos), weight)) {
+                        out << "error expected set <from> <to> <weight>\n";
+                    }
+                    else {
+                        if (command == "set") {
+                            solver_.CheckWeight(weight);
+                        }
+                        pending.push_back({ from, to, weight });
+                        out << "queued " << pending.size() << '\n';
+                    }
+                }
+                else if (command == "commit") {
+                    std::vector<EdgeUpdate> updates = std::move(pending);
+                    pending.clear();
+                    out << "published " << Apply(updates) << '\n';
+                }
+                else {
+                    out << Answer(line) << '\n';
+                }
+            }
+            catch (const std::exception& e) {
+                out << "error " << e.what() << '\n';
+            }
+            out.flush();
+        }
+    }
+
+private:
+    static constexpr std::size_t PATH_CACHE_ENTRIES = 4096;
+    // Bounds what one request line can make the server allocate.
+    static constexpr std::size_t MAX_BATCH = 65536;
+
+    // The paths cache of one thread and the snapshot it was filled from.
+    struct ThreadPaths {
+        std::weak_ptr<const Snapshot> snapshot;
+        PathCache cache{ PATH_CACHE_ENTRIES };
+    };
+
+    DenseFloydWarshall<Weight> solver_;
+    ThreadPool pool_;
+    // Accessed only through the std::atomic_* shared_ptr functions;
+    // std::atomic<std::shared_ptr> in libstdc++ 12 releases its internal
+    // lock with relaxed ordering after a load, which races with the next
+    // store.
+    std::shared_ptr<const Snapshot> snapshot_;
+    std::mutex update_mutex_;
+    uint64_t version_ = 0;
+
+    std::string AnswerQuery(std::string_view request) const {
+        std::size_t pos = 0;
+        const std::string_view command = NextToken(request, pos);
+        if (command != "dist" && command != "path") {
+            return "error expected dist or path";
+        }
+        const VertexDictionary::Id from = FindVertex(NextToken(request, pos));
+        const VertexDictionary::Id to = FindVertex(NextToken(request, pos));
+        if (from == VertexDictionary::NPOS || to == VertexDictionary::NPOS) {
+            return "error unknown vertex";
+        }
+
+        const std::shared_ptr<const Snapshot> snapshot = Current();
+        const Weight value = snapshot->rows[from]->dist[to];
+        if (value == Traits::Infinity()) {
+            return "INF";
+        }
+        if (value == Traits::NegativeInfinity()) {
+            return "-INF";
+        }
+
+        char digits[32];
+        std::string reply(DistanceWriter::FormatNumber(static_cast<double>(value), digits));
+        if (command == "path") {
+            if (snapshot->next_rows.empty()) {
+                return "error paths are not tracked";
+            }
+            thread_local ThreadPaths paths;
+            if (paths.snapshot.lock() != snapshot) {
+                paths.cache.Clear();
+                paths.snapshot = snapshot;
+            }
+            const std::span<const VertexDictionary::Id> path = paths.cache.Get(from, to, [&] {
+                return PathRange(snapshot->next_rows, from, to);
+            });
+            reply += " via path: ";
+            for (std::size_t k = 0; k < path.size(); ++k) {
+                if (k > 0) {
+                    reply += '-';
+                }
+                reply += solver_.Vertices().Name(path[k]);
+            }
+        }
+        return reply;
+    }
+
+    VertexDictionary::Id FindVertex(std::string_view name) const {
+        return name.empty() ? VertexDictionary::NPOS : solver_.Vertices().Find(name);
+    }
+
+    // Rows equal to those of the current snapshot are shared with it.
+    uint64_t Publish() {
+        const std::size_t n = solver_.Vertices().size();
+        const std::span<const Weight> dist = solver_.Distances();
+        const std::span<const int32_t> next = solver_.Successors();
+        const std::shared_ptr<const Snapshot> previous = Current();
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->version = ++version_;
+        snapshot->rows.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::span<const Weight> dist_row = dist.subspan(i * n, n);
+            const std::span<const int32_t> next_row = next.empty() ? next : next.subspan(i * n, n);
+            if (previous && std::equal(dist_row.begin(), dist_row.end(), previous->rows[i]->dist.begin())
+                && std::equal(next_row.begin(), next_row.end(), previous->rows[i]->next.begin())) {
+                snapshot->rows[i] = previous->rows[i];
+                continue;
+            }
+            snapshot->rows[i] = std::make_shared<const Row>(Row{ std::vector<Weight>(dist_row.begin(), dist_row.end()),
+                                                                 std::vector<int32_t>(next_row.begin(), next_row.end()) });
+        }
+        if (!next.empty()) {
+            for (const auto& row : snapshot->rows) {
+                snapshot->next_rows.push_back(row->next.data());
+            }
+        }
+        std::atomic_store_explicit(&snapshot_, std::shared_ptr<const Snapshot>(std::move(snapshot)),
+                                   std::memory_order_release);
+        return version_;
+    }
+};
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "instrumentation.h"
+#include "weight_traits.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FW_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Min-plus row update used by the dense kernels:
+//     row_i[j] = min(row_i[j], i_k + row_k[j]), next_i[j] = next_ik where it improved
+// for j in [begin, end). Unreachable cells hold WeightTraits<Weight>::Infinity(),
+// and the floating-point kernels need no sentinel checks at all, so the
+// update maps directly onto vector compares and masked stores. Kernels
+// instantiated with WithPaths = false never touch next_i.
+template<typename Weight>
+using RelaxRowFn = void (*)(Weight* row_i, int32_t* next_i, const Weight* row_k, Weight i_k, int32_t next_ik,
+                            std::size_t begin, std::size_t end);
+
+enum class SimdLevel {
+    Auto,
+    Scalar,
+    Avx2,
+    Avx512,
+};
+
+template<typename Weight, bool WithPaths = true>
+inline void RelaxRowScalar(Weight* row_i, int32_t* next_i, const Weight* row_k, Weight i_k, int32_t next_ik,
+                           std::size_t begin, std::size_t end) {
+    for (std::size_t j = begin; j < end; ++j) {
+        const Weight candidate = WeightTraits<Weight>::Add(i_k, row_k[j]);
+        if (candidate < row_i[j]) {
+            FW_COUNT(Counter::Updates, 1);
+            row_i[j] = candidate;
+            if constexpr (WithPaths) {
+                next_i[j] = next_ik;
+            }
+        }
+    }
+}
+
+#if defined(FW_X86_SIMD)
+
+template<bool WithPaths = true>
+__attribute__((target("avx2"))) inline void RelaxRowAvx2(double* row_i, int32_t* next_i, const double* row_k,
+                                                         double i_k, int32_t next_ik, std::size_t begin,
+                                                         std::size_t end) {
+    const __m256d via = _mm256_set1_pd(i_k);
+    const __m128i next = _mm_set1_epi32(next_ik);
+    const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+
+    std::size_t j = begin;
+    for (; j + 4 <= end; j += 4) {
+        const __m256d candidate = _mm256_add_pd(via, _mm256_loadu_pd(row_k + j));
+        const __m256d current = _mm256_loadu_pd(row_i + j);
+        const __m256d better = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+        const int improved = _mm256_movemask_pd(better);
+        if (improved == 0) {
+            continue;
+        }
+        FW_COUNT(Counter::Updates, __builtin_popcount(improved));
+
+        _mm256_storeu_pd(row_i + j, _mm256_blendv_pd(current, candidate, better));
+        if constexpr (WithPaths) {
+            const __m128i mask = _mm256_castsi256_si128(
+                _mm256_permutevar8x32_epi32(_mm256_castpd_si256(better), low_halves));
+            __m128i* next_j = reinterpret_cast<__m128i*>(next_i + j);
+            _mm_storeu_si128(next_j, _mm_blendv_epi8(_mm_loadu_si128(next_j), next, mask));
+        }
+    }
+    RelaxRowScalar<double, WithPaths>(row_i, next_i, row_k, i_k, next_ik, j, end);
+}
+
+template<bool WithPaths = true>
+__attribute__((target("avx2"))) inline void RelaxRowAvx2(float* row_i, int32_t* next_i, const float* row_k,
+                                                         float i_k, int32_t next_ik, std::size_t begin,
+                                                         std::size_t end) {
+    const __m256 via = _mm256_set1_ps(i_k);
+    const __m256i next = _mm256_set1_epi32(next_ik);
+
+    std::size_t j = begin;
+    for (; j + 8 <= end; j += 8) {
+        const __m256 candidate = _mm256_add_ps(via, _mm256_loadu_ps(row_k + j));
+        const __m256 current = _mm256_loadu_ps(row_i + j);
+        const __m256 better = _mm256_cmp_ps(candidate, current, _CMP_LT_OQ);
+        const int improved = _mm256_movemask_ps(better);
+        if (improved == 0) {
+            continue;
+        }
+        FW_COUNT(Counter::Updates, __builtin_popcount(improved));
+
+        _mm256_storeu_ps(row_i + j, _mm256_blendv_ps(current, candidate, better));
+        if constexpr (WithPaths) {
+            __m256i* next_j = reinterpret_cast<__m256i*>(next_i + j);
+            _mm256_storeu_si256(next_j,
+                                _mm256_blendv_epi8(_mm256_loadu_si256(next_j), next, _mm256_castps_si256(better)));
+        }
+    }
+    RelaxRowScalar<float, WithPaths>(row_i, next_i, row_k, i_k, next_ik, j, end);
+}
+
+// Integer lanes reproduce WeightTraits<int32_t>::Add: unreachable columns are
+// masked out and overflowing sums saturate towards the sign of the operands.
+template<bool WithPaths = true>
+__attribute__((target("avx2"))) inline void RelaxRowAvx2(int32_t* row_i, int32_t* next_i, const int32_t* row_k,
+                                                         int32_t i_k, int32_t next_ik, std::size_t begin,
+                                                         std::size_t end) {
+    if (i_k == WeightTraits<int32_t>::Infinity()) {
+        return;
+    }
+    const __m256i via = _mm256_set1_epi32(i_k);
+    const __m256i next = _mm256_set1_epi32(next_ik);
+    const __m256i infinity = _mm256_set1_epi32(WeightTraits<int32_t>::Infinity());
+    const __m256i saturated = _mm256_set1_epi32(i_k < 0 ? std::numeric_limits<int32_t>::min()
+                                                        : WeightTraits<int32_t>::Infinity());
+
+    std::size_t j = begin;
+    for (; j + 8 <= end; j += 8) {
+        const __m256i k_j = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_k + j));
+        const __m256i sum = _mm256_add_epi32(via, k_j);
+        const __m256i overflow = _mm256_srai_epi32(
+            _mm256_and_si256(_mm256_xor_si256(via, sum), _mm256_xor_si256(k_j, sum)), 31);
+        const __m256i candidate = _mm256_blendv_epi8(sum, saturated, overflow);
+
+        __m256i* row_j = reinterpret_cast<__m256i*>(row_i + j);
+        const __m256i current = _mm256_loadu_si256(row_j);
+        const __m256i better = _mm256_andnot_si256(_mm256_cmpeq_epi32(k_j, infinity),
+                                                   _mm256_cmpgt_epi32(current, candidate));
+        if (_mm256_testz_si256(better, better)) {
+            continue;
+        }
+        FW_COUNT(Counter::Updates, __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(better))));
+
+        _mm256_storeu_si256(row_j, _mm256_blendv_epi8(current, candidate, better));
+        if constexpr (WithPaths) {
+            __m256i* next_j = reinterpret_cast<__m256i*>(next_i + j);
+            _mm256_storeu_si256(next_j, _mm256_blendv_epi8(_mm256_loadu_si256(next_j), next, better));
+        }
+    }
+    RelaxRowScalar<int32_t, WithPaths>(row_i, next_i, row_k, i_k, next_ik, j, end);
+}
+
+template<bool WithPaths = true>
+__attribute__((target("avx512f,avx512vl"))) inline void RelaxRowAvx512(double* row_i, int32_t* next_i,
+                                                                      const double* row_k, double i_k,
+                                                                      int32_t next_ik, std::size_t begin,
+                                                                      std::size_t end) {
+    const __m512d via = _mm512_set1_pd(i_k);
+    const __m256i next = _mm256_set1_epi32(next_ik);
+
+    for (std::size_t j = begin; j < end; j += 8) {
+        const __mmask8 lanes = end - j >= 8 ? __mmask8(0xFF) : __mmask8((1u << (end - j)) - 1);
+        const __m512d candidate = _mm512_add_pd(via, _mm512_maskz_loadu_pd(lanes, row_k + j));
+        const __m512d current = _mm512_maskz_loadu_pd(lanes, row_i + j);
+        const __mmask8 better = _mm512_mask_cmp_pd_mask(lanes, candidate, current, _CMP_LT_OQ);
+        if (better == 0) {
+            continue;
+        }
+        FW_COUNT(Counter::Updates, __builtin_popcount(better));
+
+        _mm512_mask_storeu_pd(row_i + j, better, candidate);
+        if constexpr (WithPaths) {
+            _mm256_mask_storeu_epi32(next_i + j, better, next);
+        }
+    }
+}
+
+template<bool WithPaths = true>
+__attribute__((target("avx512f,avx512vl"))) inline void RelaxRowAvx512(float* row_i, int32_t* next_i,
+                                                                      const float* row_k, float i_k,
+                                                                      int32_t next_ik, std::size_t begin,
+                                                                      std::size_t end) {
+    const __m512 via = _mm512_set1_ps(i_k);
+    const __m512i next = _mm512_set1_epi32(next_ik);
+
+    for (std::size_t j = begin; j < end; j += 16) {
+        const __mmask16 lanes = end - j >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << (end - j)) - 1);
+        const __m512 candidate = _mm512_add_ps(via, _mm512_maskz_loadu_ps(lanes, row_k + j));
+        const __m512 current = _mm512_maskz_loadu_ps(lanes, row_i + j);
+        const __mmask16 better = _mm512_mask_cmp_ps_mask(lanes, candidate, current, _CMP_LT_OQ);
+        if (better == 0) {
+            continue;
+        }
+        FW_COUNT(Counter::Updates, __builtin_popcount(better));
+
+        _mm512_mask_storeu_ps(row_i + j, better, candidate);
+        if constexpr (WithPaths) {
+            _mm512_mask_storeu_epi32(next_i + j, better, next);
+        }
+    }
+}
+
+template<bool WithPaths = true>
+__attribute__((target("avx512f,avx512vl"))) inline void RelaxRowAvx512(int32_t* row_i, int32_t* next_i,
+                                                                      const int32_t* row_k, int32_t i_k,
+                                                                      int32_t next_ik, std::size_t begin,
+                                                                      std::size_t end) {
+    if (i_k == WeightTraits<int32_t>::Infinity()) {
+        return;
+    }
+    const __m512i via = _mm512_set1_epi32(i_k);
+    const __m512i next = _mm512_set1_epi32(next_ik);
+    const __m512i infinity = _mm512_set1_epi32(WeightTraits<int32_t>::Infinity());
+    const __m512i saturated = _mm512_set1_epi32(i_k < 0 ? std::numeric_limits<int32_t>::min()
+                                                        : WeightTraits<int32_t>::Infinity());
+
+    for (std::size_t j = begin; j < end; j += 16) {
+        const __mmask16 lanes = end - j >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << (end - j)) - 1);
+        const __m512i k_j = _mm512_maskz_loadu_epi32(lanes, row_k + j);
+        const __m512i sum = _mm512_add_epi32(via, k_j);
+        const __mmask16 overflow = _mm512_cmplt_epi32_mask(
+            _mm512_and_si512(_mm512_xor_si512(via, sum), _mm512_xor_si512(k_j, sum)), _mm512_setzero_si512());
+        const __m512i candidate = _mm512_mask_blend_epi32(overflow, sum, saturated);
+
+        const __m512i current = _mm512_maskz_loadu_epi32(lanes, row_i + j);
+        const __mmask16 reachable = _mm512_mask_cmpneq_epi32_mask(lanes, k_j, infinity);
+        const __mmask16 better = _mm512_mask_cmplt_epi32_mask(reachable, candidate, current);
+        if (better == 0) {
+            continue;
+        }
+        FW_COUNT(Counter::Updates, __builtin_popcount(better));
+
+        _mm512_mask_storeu_epi32(row_i + j, better, candidate);
+        if constexpr (WithPaths) {
+            _mm512_mask_storeu_epi32(next_i + j, better, next);
+        }
+    }
+}
+
+#endif
+
+inline SimdLevel DetectSimdLevel() {
+#if defined(FW_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+        return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::Avx2;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+// Resolves the requested level against what the CPU supports: Auto picks the
+// widest available path, an unsupported request falls back to the next
+// narrower one.
+inline SimdLevel ResolveSimdLevel(SimdLevel requested) {
+    const SimdLevel supported = DetectSimdLevel();
+    if (requested == SimdLevel::Auto || static_cast<int>(requested) > static_cast<int>(supported)) {
+        return supported;
+    }
+    return requested;
+}
+
+template<typename Weight, bool WithPaths>
+inline RelaxRowFn<Weight> SelectRelaxRow(SimdLevel level) {
+#if defined(FW_X86_SIMD)
+    switch (ResolveSimdLevel(level)) {
+    case SimdLevel::Avx512:
+        return static_cast<RelaxRowFn<Weight>>(RelaxRowAvx512<WithPaths>);
+    case SimdLevel::Avx2:
+        return static_cast<RelaxRowFn<Weight>>(RelaxRowAvx2<WithPaths>);
+    default:
+        break;
+    }
+#else
+    (void)level;
+#endif
+    return RelaxRowScalar<Weight, WithPaths>;
+}
+
+template<typename Weight>
+inline RelaxRowFn<Weight> SelectRelaxRow(SimdLevel level, bool with_paths) {
+    return with_paths ? SelectRelaxRow<Weight, true>(level) : SelectRelaxRow<Weight, false>(level);
+}
+
+// The same update over the listed columns only, for pivot rows with few
+// finite entries: `columns` holds the j with row_k[j] finite, so rows are
+// touched only where they can change.
+template<typename Weight>
+using RelaxColumnsFn = void (*)(Weight* row_i, int32_t* next_i, const Weight* row_k, Weight i_k, int32_t next_ik,
+                                const uint32_t* columns, std::size_t count);
+
+template<typename Weight, bool WithPaths = true>
+inline void RelaxColumns(Weight* row_i, int32_t* next_i, const Weight* row_k, Weight i_k, int32_t next_ik,
+                         const uint32_t* columns, std::size_t count) {
+    for (std::size_t c = 0; c < count; ++c) {
+        const uint32_t j = columns[c];
+        const Weight candidate = WeightTraits<Weight>::Add(i_k, row_k[j]);
+        if (candidate < row_i[j]) {
+            FW_COUNT(Counter::Updates, 1);
+            row_i[j] = candidate;
+            if constexpr (WithPaths) {
+                next_i[j] = next_ik;
+            }
+        }
+    }
+}
+
+template<typename Weight>
+inline RelaxColumnsFn<Weight> SelectRelaxColumns(bool with_paths) {
+    return with_paths ? RelaxColumns<Weight, true> : RelaxColumns<Weight, false>;
+}
@@ -0,0 +1,509 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "distance_writer.h"
+#include "edge_list.h"
+#include "floyd_warshall.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
+#include "path_range.h"
+#include "vertex_dictionary.h"
+#include "weight_traits.h"
+
+// Binary result file, little-endian:
+//     ResultMatrixHeader
+//     uint64_t name_end[vertex_count]   end offset of each name in the name block
+//     char     names[name_bytes]        names of vertices 0..V-1, concatenated
+//     padding to 64 bytes
+//     Weight   dist[V * V]              row-major, WeightTraits infinities for
+//                                       unreachable and unbounded pairs
+//     padding to 64 bytes               (only when successors are present)
+//     int32_t  next[V * V]              row-major successors, -1 for none
+struct ResultMatrixHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t weight_type;
+    uint64_t name_bytes;
+    uint64_t dist_offset;
+    uint64_t next_offset;
+};
+
+constexpr char RESULT_MATRIX_MAGIC[4] = { 'F', 'W', 'R', 'M' };
+constexpr uint32_t RESULT_MATRIX_VERSION = 1;
+constexpr uint64_t RESULT_MATRIX_ALIGNMENT = 64;
+
+static_assert(sizeof(ResultMatrixHeader) == 40, "result matrix layout");
+
+template<typename Weight>
+constexpr WeightType WeightTypeOf() {
+    if constexpr (std::is_same_v<Weight, int32_t>) {
+        return WeightType::Int32;
+    }
+    else if constexpr (std::is_same_v<Weight, float>) {
+        return WeightType::Float;
+    }
+    else {
+        static_assert(std::is_same_v<Weight, double>, "unsupported weight type");
+        return WeightType::Double;
+    }
+}
+
+inline uint64_t AlignResultOffset(uint64_t offset) {
+    return (offset + RESULT_MATRIX_ALIGNMENT - 1) / RESULT_MATRIX_ALIGNMENT * RESULT_MATRIX_ALIGNMENT;
+}
+
+// The path from -> to in a solved engine's matrices; empty when the pair is
+// unreachable or unbounded, or when no successors are tracked.
+template<typename Weight>
+PathRange MatrixPath(std::size_t vertex_count, std::span<const Weight> dist, std::span<const int32_t> next,
+                     VertexDictionary::Id from, VertexDictionary::Id to) {
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id out of range");
+    }
+    const Weight value = dist[from * vertex_count + to];
+    if (next.empty() || value == WeightTraits<Weight>::Infinity() || value == WeightTraits<Weight>::NegativeInfinity()) {
+        return {};
+    }
+    return PathRange(next, vertex_count, from, to);
+}
+
+// Non-owning view of a solved engine's result, as returned by its Result();
+// valid until the engine is changed or destroyed.
+template<typename Weight>
+class DistanceMatrixView {
+public:
+    using Traits = WeightTraits<Weight>;
+
+    DistanceMatrixView(const VertexDictionary& vertices, std::span<const Weight> dist, std::span<const int32_t> next)
+        : vertices_(&vertices), dist_(dist), next_(next) {
+    }
+
+    const VertexDictionary& Vertices() const {
+        return *vertices_;
+    }
+
+    bool HasPaths() const {
+        return !next_.empty();
+    }
+
+    // Traits::Infinity() when `to` is unreachable, Traits::NegativeInfinity()
+    // when the distance is unbounded below.
+    Weight Distance(VertexDictionary::Id from, VertexDictionary::Id to) const {
+        if (from >= vertices_->size() || to >= vertices_->size()) {
+            throw std::out_of_range("Vertex id out of range");
+        }
+        return dist_[from * vertices_->size() + to];
+    }
+
+    PathRange Path(VertexDictionary::Id from, VertexDictionary::Id to) const {
+        return MatrixPath<Weight>(vertices_->size(), dist_, next_, from, to);
+    }
+
+    // Row-major V*V matrices; Successors() is empty without paths.
+    std::span<const Weight> Distances() const {
+        return dist_;
+    }
+
+    std::span<const int32_t> Successors() const {
+        return next_;
+    }
+
+private:
+    const VertexDictionary* vertices_;
+    std::span<const Weight> dist_;
+    std::span<const int32_t> next_;
+};
+
+// Emits "start-...-end" into the writer as the walk goes; `path` is a
+// PathRange or any other range of vertex ids.
+template<typename Path>
+void WritePath(DistanceWriter& out, const VertexDictionary& vertices, const Path& path) {
+    bool first = true;
+    for (VertexDictionary::Id vertex : path) {
+        if (!first) {
+            out.Write('-');
+        }
+        out.Write(vertices.Name(vertex));
+        first = false;
+    }
+}
+
+// Writes "from: a to: b - d" of one text result line, or the whole line
+// with its newline for an INF or -INF distance. Returns whether the distance
+// is finite, in which case the caller may add the "via path" column and
+// ends the line.
+template<typename Weight>
+bool WriteDistance(DistanceWriter& out, const VertexDictionary& vertices, VertexDictionary::Id from,
+                   VertexDictionary::Id to, Weight value) {
+    using Traits = WeightTraits<Weight>;
+    out.Write("from: ");
+    out.Write(vertices.Name(from));
+    out.Write(" to: ");
+    out.Write(vertices.Name(to));
+    if (value == Traits::Infinity()) {
+        out.Write(" - INF\n");
+        return false;
+    }
+    if (value == Traits::NegativeInfinity()) {
+        out.Write(" - -INF\n");
+        return false;
+    }
+    out.Write(" - ");
+    out.WriteNumber(static_cast<double>(value));
+    return true;
+}
+
+// The text result shared by all matrix engines, in the format of
+// FloydWarshall::PrintDistances; the "via path" column is left out when
+// `next` is empty.
+template<typename Weight>
+void PrintDistanceMatrix(const std::string& file_name, const VertexDictionary& vertices,
+                         std::span<const Weight> dist, std::span<const int32_t> next) {
+    FW_PHASE(Phase::PrintDistances);
+    DistanceWriter file_out(file_name);
+    const std::size_t n = vertices.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+            if (i == j || !WriteDistance<Weight>(file_out, vertices, i, j, dist[i * n + j])) {
+                continue;
+            }
+            if (!next.empty()) {
+                file_out.Write(" via path: ");
+                WritePath(file_out, vertices, PathRange(next, n, i, j));
+            }
+            file_out.Write('\n');
+        }
+    }
+    file_out.Close();
+}
+
+// Restricts the text result to some sources and targets, all vertices when
+// either list is empty. With `top` set, each source keeps only its `top`
+// nearest reachable targets, nearest first (ties by vertex id); otherwise
+// the lines are those of the full result, in the same order.
+struct DistanceQuery {
+    std::vector<VertexDictionary::Id> sources;
+    std::vector<VertexDictionary::Id> targets;
+    std::size_t top = 0;
+};
+
+// Streams the lines of `query`. distance(from, to) gives a distance and
+// append_path(from, to, path) appends the vertices of its path, both ends
+// included, so any engine that can answer single pairs can be printed.
+template<typename Weight, typename DistanceFn, typename AppendPathFn>
+void PrintDistanceQuery(const std::string& file_name, const VertexDictionary& vertices, const DistanceQuery& query,
+                        bool with_paths, DistanceFn&& distance, AppendPathFn&& append_path) {
+    FW_PHASE(Phase::PrintDistances);
+    using Id = VertexDictionary::Id;
+    using Traits = WeightTraits<Weight>;
+    auto selected = [&vertices](const std::vector<Id>& ids) {
+        std::vector<Id> sorted = ids;
+        if (sorted.empty()) {
+            sorted.resize(vertices.size());
+            for (std::size_t v = 0; v < sorted.size(); ++v) {
+                sorted[v] = static_cast<Id>(v);
+            }
+        }
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        return sorted;
+    };
+    const std::vector<Id> sources = selected(query.sources);
+    const std::vector<Id> targets = selected(query.targets);
+
+    DistanceWriter file_out(file_name);
+    std::vector<std::pair<Weight, Id>> nearest;
+    std::vector<Id> path;
+    auto write_line = [&](Id from, Id to, Weight value) {
+        if (!WriteDistance<Weight>(file_out, vertices, from, to, value)) {
+            return;
+        }
+        if (with_paths) {
+            path.clear();
+            append_path(from, to, path);
+            file_out.Write(" via path: ");
+            WritePath(file_out, vertices, path);
+        }
+        file_out.Write('\n');
+    };
+
+    for (Id from : sources) {
+        if (query.top == 0) {
+            for (Id to : targets) {
+                if (to != from) {
+                    write_line(from, to, distance(from, to));
+                }
+            }
+            continue;
+        }
+        nearest.clear();
+        for (Id to : targets) {
+            const Weight value = distance(from, to);
+            if (to != from && value != Traits::Infinity()) {
+                nearest.emplace_back(value, to);
+            }
+        }
+        const std::size_t keep = std::min(query.top, nearest.size());
+        std::partial_sort(nearest.begin(), nearest.begin() + keep, nearest.end());
+        for (std::size_t t = 0; t < keep; ++t) {
+            write_line(from, nearest[t].second, nearest[t].first);
+        }
+    }
+    file_out.Close();
+}
+
+// The header of a result file for `vertices`, with the matrix offsets laid
+// out as described above.
+template<typename Weight>
+ResultMatrixHeader MakeResultMatrixHeader(const VertexDictionary& vertices, bool with_next) {
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("Binary results are only supported on little-endian hosts");
+    }
+
+    const std::size_t n = vertices.size();
+    ResultMatrixHeader header = {};
+    std::memcpy(header.magic, RESULT_MATRIX_MAGIC, sizeof(header.magic));
+    header.version = RESULT_MATRIX_VERSION;
+    header.vertex_count = static_cast<uint32_t>(n);
+    header.weight_type = static_cast<uint32_t>(WeightTypeOf<Weight>());
+    for (std::size_t v = 0; v < n; ++v) {
+        header.name_bytes += vertices.Name(v).size();
+    }
+    const uint64_t names_end = sizeof(header) + n * sizeof(uint64_t) + header.name_bytes;
+    header.dist_offset = AlignResultOffset(names_end);
+    const uint64_t dist_end = header.dist_offset + uint64_t(n) * n * sizeof(Weight);
+    header.next_offset = with_next ? AlignResultOffset(dist_end) : 0;
+    return header;
+}
+
+// Writes everything before the distance matrix: the header, the name table
+// and the padding up to header.dist_offset.
+inline void WriteResultMatrixPrefix(DistanceWriter& out, const ResultMatrixHeader& header,
+                                    const VertexDictionary& vertices) {
+    const std::size_t n = vertices.size();
+    std::vector<uint64_t> name_end(n);
+    uint64_t name_bytes = 0;
+    for (std::size_t v = 0; v < n; ++v) {
+        name_bytes += vertices.Name(v).size();
+        name_end[v] = name_bytes;
+    }
+    const uint64_t names_end = sizeof(header) + n * sizeof(uint64_t) + name_bytes;
+
+    const char padding[RESULT_MATRIX_ALIGNMENT] = {};
+    out.Write(std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)));
+    out.Write(std::string_view(reinterpret_cast<const char*>(name_end.data()), n * sizeof(uint64_t)));
+    for (std::size_t v = 0; v < n; ++v) {
+        out.Write(vertices.Name(v));
+    }
+    out.Write(std::string_view(padding, header.dist_offset - names_end));
+}
+
+// Writes a result file whose matrices are produced by callbacks:
+// write_dist(out) and, when with_next is set, write_next(out) each append
+// V * V cells in row-major order. Lets matrices that are not held as one
+// span, like the tiles of OutOfCoreFloydWarshall, be streamed straight out.
+template<typename Weight, typename WriteDist, typename WriteNext>
+void WriteResultMatrixStreamed(const std::string& file_name, const VertexDictionary& vertices, bool with_next,
+                               WriteDist&& write_dist, WriteNext&& write_next) {
+    FW_PHASE(Phase::PrintDistances);
+    const ResultMatrixHeader header = MakeResultMatrixHeader<Weight>(vertices, with_next);
+    const std::size_t n = vertices.size();
+    const uint64_t dist_end = header.dist_offset + uint64_t(n) * n * sizeof(Weight);
+
+    const char padding[RESULT_MATRIX_ALIGNMENT] = {};
+    DistanceWriter file_out(file_name);
+    WriteResultMatrixPrefix(file_out, header, vertices);
+    write_dist(file_out);
+    if (with_next) {
+        file_out.Write(std::string_view(padding, header.next_offset - dist_end));
+        write_next(file_out);
+    }
+    file_out.Close();
+}
+
+// Writes the matrices as they are held in memory; `next` is left out when
+// empty.
+template<typename Weight>
+void WriteResultMatrix(const std::string& file_name, const VertexDictionary& vertices,
+                       std::span<const Weight> dist, std::span<const int32_t> next) {
+    WriteResultMatrixStreamed<Weight>(
+        file_name, vertices, !next.empty(),
+        [dist](DistanceWriter& out) {
+            out.Write(std::string_view(reinterpret_cast<const char*>(dist.data()), dist.size_bytes()));
+        },
+        [next](DistanceWriter& out) {
+            out.Write(std::string_view(reinterpret_cast<const char*>(next.data()), next.size_bytes()));
+        });
+}
+
+// The file adapters over a result view; the paths are taken as given.
+template<typename Weight>
+void PrintDistanceMatrix(const std::string& file_name, const DistanceMatrixView<Weight>& result) {
+    PrintDistanceMatrix<Weight>(file_name, result.Vertices(), result.Distances(), result.Successors());
+}
+
+template<typename Weight>
+void WriteResultMatrix(const std::string& file_name, const DistanceMatrixView<Weight>& result) {
+    WriteResultMatrix<Weight>(file_name, result.Vertices(), result.Distances(), result.Successors());
+}
+
+template<typename Weight>
+void PrintDistanceQuery(const std::string& file_name, const DistanceMatrixView<Weight>& result,
+                        const DistanceQuery& query) {
+    PrintDistanceQuery<Weight>(
+        file_name, result.Vertices(), query, result.HasPaths(),
+        [&result](VertexDictionary::Id from, VertexDictionary::Id to) { return result.Distance(from, to); },
+        [&result](VertexDictionary::Id from, VertexDictionary::Id to, std::vector<VertexDictionary::Id>& path) {
+            const PathRange range = result.Path(from, to);
+            path.insert(path.end(), range.begin(), range.end());
+        });
+}
+
+// Answers queries straight from a mapped result file. Only the name table is
+// read up front; matrix pages are faulted in as queries touch them.
+class ResultMatrixView {
+public:
+    explicit ResultMatrixView(const std::string& file_name)
+        : file_(std::make_shared<const MappedFile>(file_name, MappedFile::Access::Random)) {
+        if constexpr (std::endian::native != std::endian::little) {
+            throw std::runtime_error("Binary results are only supported on little-endian hosts");
+        }
+
+        const std::string_view data = file_->data();
+        if (data.size() < sizeof(header_) || std::memcmp(data.data(), RESULT_MATRIX_MAGIC, sizeof(RESULT_MATRIX_MAGIC)) != 0) {
+            throw std::runtime_error("Not a result matrix: " + file_name);
+        }
+        std::memcpy(&header_, data.data(), sizeof(header_));
+        if (header_.version != RESULT_MATRIX_VERSION) {
+            throw std::runtime_error("Unsupported result matrix version");
+        }
+
+        // vertex_count is 32-bit, so neither of these can overflow.
+        const uint64_t n = header_.vertex_count;
+        const uint64_t names_offset = sizeof(header_) + n * sizeof(uint64_t);
+        const uint64_t cells = n * n;
+        std::size_t weight_size = 0;
+        switch (static_cast<WeightType>(header_.weight_type)) {
+        case WeightType::Int32:
+            weight_size = sizeof(int32_t);
+            break;
+        case WeightType::Float:
+            weight_size = sizeof(float);
+            break;
+        case WeightType::Double:
+            weight_size = sizeof(double);
+            break;
+        default:
+            throw std::runtime_error("Unsupported result matrix weight type");
+        }
+        // As in ReadBinaryEdgeList, each field is checked against the file
+        // size on its own before fields are combined, so nothing can wrap.
+        const uint64_t size = data.size();
+        if (names_offset > size || header_.name_bytes > size - names_offset || header_.dist_offset > size
+            || header_.dist_offset < names_offset + header_.name_bytes || header_.dist_offset % weight_size != 0
+            || cells > (size - header_.dist_offset) / weight_size) {
+            throw std::runtime_error("Corrupt result matrix");
+        }
+        const uint64_t dist_end = header_.dist_offset + cells * weight_size;
+        if (header_.next_offset
+            && (header_.next_offset > size || header_.next_offset < dist_end
+                || header_.next_offset % sizeof(int32_t) != 0
+                || cells > (size - header_.next_offset) / sizeof(int32_t))) {
+            throw std::runtime_error("Corrupt result matrix");
+        }
+
+        vertices_.Reserve(n);
+        uint64_t name_begin = 0;
+        for (uint64_t v = 0; v < n; ++v) {
+            uint64_t name_end;
+            std::memcpy(&name_end, data.data() + sizeof(header_) + v * sizeof(uint64_t), sizeof(name_end));
+            if (name_end < name_begin || name_end > header_.name_bytes
+                || vertices_.InternView(data.substr(names_offset + name_begin, name_end - name_begin)) != v) {
+                throw std::runtime_error("Corrupt result matrix");
+            }
+            name_begin = name_end;
+        }
+        vertices_.KeepAlive(file_);
+    }
+
+    const VertexDictionary& Vertices() const {
+        return vertices_;
+    }
+
+    bool HasPaths() const {
+        return header_.next_offset != 0;
+    }
+
+    // +infinity when v is unreachable from u, -infinity when the distance is
+    // unbounded below.
+    double Distance(uint32_t u, uint32_t v) const {
+        const std::size_t cell = Cell(u, v);
+        switch (static_cast<WeightType>(header_.weight_type)) {
+        case WeightType::Int32:
+            return Widen(Load<int32_t>(header_.dist_offset, cell));
+        case WeightType::Float:
+            return Widen(Load<float>(header_.dist_offset, cell));
+        default:
+            return Widen(Load<double>(header_.dist_offset, cell));
+        }
+    }
+
+    // Walks the mapped successor matrix lazily; empty when there is no
+    // finite path.
+    PathRange Path(uint32_t u, uint32_t v) const {
+        if (!HasPaths()) {
+            throw std::runtime_error("The result matrix holds no successors");
+        }
+        if (!std::isfinite(Distance(u, v))) {
+            return {};
+        }
+        const std::size_t cells = static_cast<std::size_t>(header_.vertex_count) * header_.vertex_count;
+        const auto* next = reinterpret_cast<const int32_t*>(file_->data().data() + header_.next_offset);
+        return PathRange({ next, cells }, header_.vertex_count, u, v);
+    }
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    ResultMatrixHeader header_;
+    VertexDictionary vertices_;
+
+    std::size_t Cell(uint32_t u, uint32_t v) const {
+        if (u >= header_.vertex_count || v >= header_.vertex_count) {
+            throw std::out_of_range("Vertex id out of range");
+        }
+        return static_cast<std::size_t>(u) * header_.vertex_count + v;
+    }
+
+    template<typename T>
+    T Load(uint64_t offset, std::size_t cell) const {
+        T value;
+        std::memcpy(&value, file_->data().data() + offset + cell * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    static double Widen(T value) {
+        if (value == WeightTraits<T>::Infinity()) {
+            return std::numeric_limits<double>::infinity();
+        }
+        if (value == WeightTraits<T>::NegativeInfinity()) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        return static_cast<double>(value);
+    }
+};
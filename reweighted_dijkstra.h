@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <queue>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "edge_list.h"
+#include "instrumentation.h"
+
+// The two halves of Johnson's algorithm, shared by Johnson and
+// SourceShortestPaths: Bellman-Ford potentials from a virtual source, and
+// Dijkstra on the edges those potentials make non-negative. Both work on an
+// adjacency list, so the same code serves the forward and the reversed graph.
+
+// Out-edges of u are targets[first_edge[u] .. first_edge[u + 1]).
+struct Adjacency {
+    std::vector<uint32_t> first_edge;
+    std::vector<uint32_t> targets;
+    std::vector<double> weights;
+};
+
+// Like the matrix engines, the last of several edges between the same pair
+// wins and self-loops are dropped, since dist[v][v] is 0 by definition there.
+// Weights are rounded to Weight first, so every engine sees the same values.
+template<typename Weight>
+Adjacency MakeAdjacency(std::span<const Edge> edges, std::size_t vertex_count) {
+    std::vector<Edge> sorted(edges.begin(), edges.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Edge& lhs, const Edge& rhs) {
+        return lhs.from != rhs.from ? lhs.from < rhs.from : lhs.to < rhs.to;
+    });
+
+    Adjacency graph;
+    graph.first_edge.assign(vertex_count + 1, 0);
+    graph.targets.reserve(sorted.size());
+    graph.weights.reserve(sorted.size());
+    for (std::size_t e = 0; e < sorted.size(); ++e) {
+        const Edge& edge = sorted[e];
+        if (edge.from == edge.to
+            || (e + 1 < sorted.size() && sorted[e + 1].from == edge.from && sorted[e + 1].to == edge.to)) {
+            continue;
+        }
+        graph.targets.push_back(edge.to);
+        graph.weights.push_back(static_cast<double>(static_cast<Weight>(edge.weight)));
+        ++graph.first_edge[edge.from + 1];
+    }
+    for (std::size_t v = 0; v < vertex_count; ++v) {
+        graph.first_edge[v + 1] += graph.first_edge[v];
+    }
+    return graph;
+}
+
+// The same edges with every direction flipped.
+inline Adjacency Reversed(const Adjacency& graph) {
+    const std::size_t n = graph.first_edge.size() - 1;
+    Adjacency reversed;
+    reversed.first_edge.assign(n + 1, 0);
+    for (uint32_t target : graph.targets) {
+        ++reversed.first_edge[target + 1];
+    }
+    for (std::size_t v = 0; v < n; ++v) {
+        reversed.first_edge[v + 1] += reversed.first_edge[v];
+    }
+    reversed.targets.resize(graph.targets.size());
+    reversed.weights.resize(graph.weights.size());
+    std::vector<uint32_t> fill(reversed.first_edge.begin(), reversed.first_edge.end() - 1);
+    for (std::size_t u = 0; u < n; ++u) {
+        for (uint32_t e = graph.first_edge[u]; e < graph.first_edge[u + 1]; ++e) {
+            const uint32_t slot = fill[graph.targets[e]]++;
+            reversed.targets[slot] = static_cast<uint32_t>(u);
+            reversed.weights[slot] = graph.weights[e];
+        }
+    }
+    return reversed;
+}
+
+// Bellman-Ford from a virtual source joined to every vertex by a zero-weight
+// edge, which leaves w(u, v) + h(u) - h(v) >= 0 on every edge. Returns false
+// if there is a negative cycle, with its vertices in `cycle`, in order.
+inline bool BellmanFordPotentials(const Adjacency& graph, std::vector<double>& potential, std::vector<uint32_t>& cycle) {
+    const std::size_t n = graph.first_edge.size() - 1;
+    potential.assign(n, 0);
+    cycle.clear();
+    if (std::all_of(graph.weights.begin(), graph.weights.end(), [](double w) { return w >= 0; })) {
+        return true;
+    }
+    std::vector<int32_t> parent(n, -1);
+    std::size_t last_updated = n;
+
+    for (std::size_t round = 0; round <= n; ++round) {
+        last_updated = n;
+        for (std::size_t u = 0; u < n; ++u) {
+            for (uint32_t e = graph.first_edge[u]; e < graph.first_edge[u + 1]; ++e) {
+                const double candidate = potential[u] + graph.weights[e];
+                if (candidate < potential[graph.targets[e]]) {
+                    potential[graph.targets[e]] = candidate;
+                    parent[graph.targets[e]] = static_cast<int32_t>(u);
+                    last_updated = graph.targets[e];
+                }
+            }
+        }
+        if (last_updated == n) {
+            return true;
+        }
+    }
+
+    // Still relaxing after n rounds: walking parents n times from the last
+    // updated vertex ends up on the cycle.
+    std::size_t on_cycle = last_updated;
+    for (std::size_t step = 0; step < n; ++step) {
+        on_cycle = static_cast<std::size_t>(parent[on_cycle]);
+    }
+    std::size_t current = on_cycle;
+    do {
+        cycle.push_back(static_cast<uint32_t>(current));
+        current = static_cast<std::size_t>(parent[current]);
+    } while (current != on_cycle);
+    std::reverse(cycle.begin(), cycle.end());
+    return false;
+}
+
+// Dijkstra from `root` on the edges reweighted by the potentials. `sign` is
+// -1 on a reversed graph, whose edges are made non-negative by the negated
+// potentials. settle(u, distance) is called once per reached vertex with its
+// distance in the original weights, improve(u, v) whenever the best known way
+// to v changes to run through u. The scratch arrays and the heap come from
+// one arena sized for the common case, which replaces the separate
+// allocations and the heap's regrowth with a single block per root.
+template<typename Settle, typename Improve>
+void ReweightedDijkstra(const Adjacency& graph, std::span<const double> potential, double sign, std::size_t root,
+                        Settle&& settle, Improve&& improve) {
+    const std::size_t n = graph.first_edge.size() - 1;
+    using Entry = std::pair<double, uint32_t>;
+    std::pmr::monotonic_buffer_resource arena(n * (sizeof(double) + 1) + (n + 16) * sizeof(Entry) * 2);
+    std::pmr::vector<double> reduced(n, std::numeric_limits<double>::infinity(), &arena);
+    std::pmr::vector<char> settled(n, 0, &arena);
+    std::pmr::vector<Entry> heap(&arena);
+    heap.reserve(n + 16);
+    std::priority_queue<Entry, std::pmr::vector<Entry>, std::greater<Entry>> queue(std::greater<Entry>(),
+                                                                                  std::move(heap));
+
+    reduced[root] = 0;
+    queue.push({ 0.0, static_cast<uint32_t>(root) });
+    while (!queue.empty()) {
+        const auto [reached, u] = queue.top();
+        queue.pop();
+        if (settled[u]) {
+            continue;
+        }
+        settled[u] = true;
+        settle(u, reached - sign * potential[root] + sign * potential[u]);
+
+        FW_COUNT(Counter::Relaxations, graph.first_edge[u + 1] - graph.first_edge[u]);
+        for (uint32_t e = graph.first_edge[u]; e < graph.first_edge[u + 1]; ++e) {
+            const uint32_t v = graph.targets[e];
+            const double candidate =
+                reached + std::max(0.0, graph.weights[e] + sign * potential[u] - sign * potential[v]);
+            if (candidate < reduced[v]) {
+                FW_COUNT(Counter::Updates, 1);
+                reduced[v] = candidate;
+                improve(u, v);
+                queue.push({ candidate, v });
+            }
+        }
+    }
+}
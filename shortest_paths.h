@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "dense_floyd_warshall.h"
+#include "edge_list.h"
+#include "fixed_floyd_warshall.h"
+#include "johnson.h"
+#include "result_matrix.h"
+#include "vertex_dictionary.h"
+
+// In-process entry point: build the graph from memory, solve it and read the
+// result through a DistanceMatrixView, without going through input/ or
+// output/:
+//     const NamedEdge edges[] = { { "a", "b", 2 }, { "b", "c", 3 } };
+//     ShortestPaths<double> paths(MakeEdgeList(edges));
+//     const DistanceMatrixView<double> result = paths.Result();
+//     result.Distance(result.Vertices().Find("a"), result.Vertices().Find("c"));  // 5
+// Files are only an adapter on top: PrintDistanceMatrix and WriteResultMatrix
+// write a view to the path they are given.
+
+struct NamedEdge {
+    std::string_view from;
+    std::string_view to;
+    double weight;
+};
+
+// From a range of edges that each unpack as [from, to, weight], e.g.
+// NamedEdge or std::tuple<std::string, std::string, int>. Names are copied
+// into the vertex dictionary, ids are assigned in order of first appearance
+// as when loading a file.
+template<typename Iterator, typename Sentinel>
+EdgeList MakeEdgeList(Iterator first, Sentinel last) {
+    EdgeList graph;
+    if constexpr (std::sized_sentinel_for<Sentinel, Iterator>) {
+        graph.edges.reserve(static_cast<std::size_t>(last - first));
+    }
+    for (; first != last; ++first) {
+        const auto& [from, to, weight] = *first;
+        const VertexDictionary::Id from_id = graph.vertices.Intern(from);
+        const VertexDictionary::Id to_id = graph.vertices.Intern(to);
+        graph.edges.push_back({ from_id, to_id, static_cast<double>(weight) });
+    }
+    return graph;
+}
+
+inline EdgeList MakeEdgeList(std::span<const NamedEdge> edges) {
+    return MakeEdgeList(edges.begin(), edges.end());
+}
+
+// From an adjacency range whose elements unpack as [vertex, neighbours], with
+// each neighbour unpacking as [to, weight], e.g.
+// std::map<std::string, std::vector<std::pair<std::string, double>>>.
+// Vertices without neighbours are kept as isolated vertices.
+template<typename Iterator, typename Sentinel>
+EdgeList MakeEdgeListFromAdjacency(Iterator first, Sentinel last) {
+    EdgeList graph;
+    for (; first != last; ++first) {
+        const auto& [vertex, neighbours] = *first;
+        const VertexDictionary::Id from = graph.vertices.Intern(vertex);
+        for (const auto& [to, weight] : neighbours) {
+            graph.edges.push_back({ from, graph.vertices.Intern(to), static_cast<double>(weight) });
+        }
+    }
+    return graph;
+}
+
+// Takes both vectors over without copying them: vertex i is names[i], and
+// the dictionary refers to the names where they already are. Names must be
+// distinct.
+inline EdgeList MakeEdgeList(std::vector<std::string> names, std::vector<Edge> edges) {
+    auto owner = std::make_shared<const std::vector<std::string>>(std::move(names));
+    EdgeList graph;
+    graph.vertices.Reserve(owner->size());
+    for (const std::string& name : *owner) {
+        if (graph.vertices.InternView(name) + 1 != graph.vertices.size()) {
+            throw std::invalid_argument("Duplicate vertex name: " + name);
+        }
+    }
+    graph.vertices.KeepAlive(owner);
+    for (const Edge& edge : edges) {
+        if (edge.from >= owner->size() || edge.to >= owner->size()) {
+            throw std::out_of_range("Edge endpoint out of range");
+        }
+    }
+    graph.edges = std::move(edges);
+    return graph;
+}
+
+// Solves the graph on construction with the engine the command line picks
+// for --engine=auto: SmallFloydWarshall up to FIXED_MAX_VERTICES vertices,
+// Johnson for sparse graphs and DenseFloydWarshall otherwise. Throws
+// NegativeCycleException as the engines do.
+template<typename Weight = double>
+class ShortestPaths {
+public:
+    explicit ShortestPaths(EdgeList graph, const DenseOptions& options = {})
+        : engine_(Solve(std::move(graph), options)) {
+    }
+
+    DistanceMatrixView<Weight> Result() const {
+        return std::visit([](const auto& engine) { return engine.Result(); }, engine_);
+    }
+
+private:
+    using Engine = std::variant<SmallFloydWarshall<Weight>, Johnson<Weight>, DenseFloydWarshall<Weight>>;
+
+    Engine engine_;
+
+    static Engine Solve(EdgeList graph, const DenseOptions& options) {
+        if (graph.vertices.size() <= FIXED_MAX_VERTICES) {
+            return SolveWith<SmallFloydWarshall<Weight>>(std::move(graph), options);
+        }
+        if (PreferJohnson(graph)) {
+            return SolveWith<Johnson<Weight>>(std::move(graph), options);
+        }
+        return SolveWith<DenseFloydWarshall<Weight>>(std::move(graph), options);
+    }
+
+    template<typename Solver>
+    static Engine SolveWith(EdgeList graph, const DenseOptions& options) {
+        Engine engine(std::in_place_type<Solver>, std::move(graph), options);
+        std::get<Solver>(engine).GenerateDistanceMatrix();
+        return engine;
+    }
+};
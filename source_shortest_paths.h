@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dense_floyd_warshall.h"
+#include "edge_list.h"
+#include "instrumentation.h"
+#include "result_matrix.h"
+#include "reweighted_dijkstra.h"
+#include "thread_pool.h"
+#include "vertex_dictionary.h"
+#include "weight_traits.h"
+
+// Shortest paths from a few roots only, in O(V) memory per root instead of
+// the V x V matrices: Dijkstra on weights reweighted by Bellman-Ford
+// potentials, as in Johnson, or plain Bellman-Ford per root when a negative
+// cycle leaves no potentials under NegativeCyclePolicy::Mark. Roots are
+// either sources, giving their rows of the distance matrix, or targets,
+// giving their columns by searching the reversed graph. Uses the threads,
+// track_paths and negative_cycles fields of DenseOptions; with Fail any
+// negative cycle in the graph throws, as the all-pairs engines do.
+template<typename Weight = double>
+class SourceShortestPaths {
+public:
+    using Traits = WeightTraits<Weight>;
+    using Id = VertexDictionary::Id;
+
+    enum class Direction {
+        FromSources,
+        ToTargets,
+    };
+
+    SourceShortestPaths(EdgeList graph, const DenseOptions& options = {})
+        : options_(options) {
+        InitEdges(std::move(graph));
+    }
+
+    void Solve(std::span<const Id> roots, Direction direction) {
+        FW_PHASE(Phase::GenerateDistanceMatrix);
+        const std::size_t n = vertices_.size();
+        direction_ = direction;
+        roots_.clear();
+        row_of_.assign(n, -1);
+        for (Id root : roots) {
+            if (root >= n) {
+                throw std::out_of_range("Vertex id out of range");
+            }
+            if (row_of_[root] < 0) {
+                row_of_[root] = static_cast<int32_t>(roots_.size());
+                roots_.push_back(root);
+            }
+        }
+        dist_.assign(roots_.size() * n, Traits::Infinity());
+        if (options_.track_paths) {
+            tree_.assign(roots_.size() * n, -1);
+        }
+
+        const bool reversed = direction == Direction::ToTargets;
+        const bool potentials = ComputePotentials();
+        ThreadPool pool(options_.threads);
+        pool.ParallelFor(roots_.size(), [&](std::size_t row) {
+            if (potentials) {
+                Dijkstra(row, reversed ? reversed_ : forward_, reversed ? -1.0 : 1.0);
+            }
+            else {
+                BellmanFord(row, reversed ? reversed_ : forward_);
+            }
+        });
+    }
+
+    const VertexDictionary& Vertices() const {
+        return vertices_;
+    }
+
+    bool HasPaths() const {
+        return options_.track_paths;
+    }
+
+    // Only pairs whose source (or, for ToTargets, target) was a root.
+    Weight Distance(Id from, Id to) const {
+        const auto [row, column] = Cell(from, to);
+        return dist_[row * vertices_.size() + column];
+    }
+
+    // Appends the vertices of the shortest path from -> to, both ends
+    // included; nothing when there is no finite path.
+    void AppendPath(Id from, Id to, std::vector<Id>& path) const {
+        const Weight value = Distance(from, to);
+        if (!options_.track_paths || value == Traits::Infinity() || value == Traits::NegativeInfinity()) {
+            return;
+        }
+        const std::size_t n = vertices_.size();
+        const auto [row, column] = Cell(from, to);
+        const int32_t* tree = &tree_[row * n];
+        const std::size_t first = path.size();
+        // Parents lead back to a source; successors lead on to a target.
+        Id current = static_cast<Id>(column);
+        path.push_back(current);
+        for (std::size_t steps = 0; current != roots_[row]; ++steps) {
+            if (tree[current] < 0 || steps > n) {
+                throw CycleDetectedException();
+            }
+            current = static_cast<Id>(tree[current]);
+            path.push_back(current);
+        }
+        if (direction_ == Direction::FromSources) {
+            std::reverse(path.begin() + first, path.end());
+        }
+    }
+
+    // The text lines of the query, in the format of PrintDistances.
+    void PrintDistances(const std::string& file_name, const DistanceQuery& query) const {
+        PrintDistanceQuery<Weight>("output/" + file_name, vertices_, query, options_.track_paths,
+                                   [this](Id from, Id to) { return Distance(from, to); },
+                                   [this](Id from, Id to, std::vector<Id>& path) { AppendPath(from, to, path); });
+    }
+
+private:
+    DenseOptions options_;
+    VertexDictionary vertices_;
+    Adjacency forward_;
+    Adjacency reversed_;
+    std::vector<double> potential_;
+    Direction direction_ = Direction::FromSources;
+    std::vector<Id> roots_;
+    std::vector<int32_t> row_of_;
+    // One row of V per root: distances, and the parent (FromSources) or the
+    // successor (ToTargets) of every vertex in the root's shortest-path tree.
+    std::vector<Weight> dist_;
+    std::vector<int32_t> tree_;
+
+    std::pair<std::size_t, std::size_t> Cell(Id from, Id to) const {
+        const std::size_t n = vertices_.size();
+        if (from >= n || to >= n) {
+            throw std::out_of_range("Vertex id out of range");
+        }
+        const Id root = direction_ == Direction::FromSources ? from : to;
+        if (row_of_[root] < 0) {
+            throw std::out_of_range("Vertex was not solved for");
+        }
+        return { static_cast<std::size_t>(row_of_[root]), direction_ == Direction::FromSources ? to : from };
+    }
+
+    void InitEdges(EdgeList graph) {
+        FW_PHASE(Phase::InitEdges);
+        vertices_ = std::move(graph.vertices);
+        forward_ = MakeAdjacency<Weight>(graph.Edges(), vertices_.size());
+        reversed_ = Reversed(forward_);
+    }
+
+    // Returns false if there is a negative cycle and the policy is Mark;
+    // throws NegativeCycleException under Fail.
+    bool ComputePotentials() {
+        std::vector<uint32_t> cycle;
+        if (BellmanFordPotentials(forward_, potential_, cycle)) {
+            return true;
+        }
+        if (options_.negative_cycles == NegativeCyclePolicy::Mark) {
+            return false;
+        }
+        std::vector<std::string> names;
+        for (uint32_t v : cycle) {
+            names.emplace_back(vertices_.Name(v));
+        }
+        throw NegativeCycleException(std::move(names));
+    }
+
+    void Dijkstra(std::size_t row, const Adjacency& graph, double sign) {
+        const std::size_t n = vertices_.size();
+        Weight* dist = &dist_[row * n];
+        int32_t* tree = options_.track_paths ? &tree_[row * n] : nullptr;
+        ReweightedDijkstra(graph, potential_, sign, roots_[row],
+            [dist](uint32_t u, double reached) {
+                dist[u] = static_cast<Weight>(reached);
+            },
+            [tree](uint32_t u, uint32_t v) {
+                if (tree) {
+                    tree[v] = static_cast<int32_t>(u);
+                }
+            });
+    }
+
+    // Only used with a negative cycle under Mark: V - 1 rounds, then every
+    // vertex still improving, and all it reaches, is unbounded.
+    void BellmanFord(std::size_t row, const Adjacency& graph) {
+        const std::size_t n = vertices_.size();
+        std::vector<double> reached(n, std::numeric_limits<double>::infinity());
+        int32_t* tree = options_.track_paths ? &tree_[row * n] : nullptr;
+        reached[roots_[row]] = 0;
+        auto relax_all = [&](bool record) {
+            std::vector<uint32_t> improved;
+            for (std::size_t u = 0; u < n; ++u) {
+                if (reached[u] == std::numeric_limits<double>::infinity()) {
+                    continue;
+                }
+                FW_COUNT(Counter::Relaxations, graph.first_edge[u + 1] - graph.first_edge[u]);
+                for (uint32_t e = graph.first_edge[u]; e < graph.first_edge[u + 1]; ++e) {
+                    const uint32_t v = graph.targets[e];
+                    if (reached[u] + graph.weights[e] < reached[v]) {
+                        if (record) {
+                            improved.push_back(v);
+                            continue;
+                        }
+                        reached[v] = reached[u] + graph.weights[e];
+                        if (tree) {
+                            tree[v] = static_cast<int32_t>(u);
+                        }
+                        improved.push_back(v);
+                    }
+                }
+            }
+            return improved;
+        };
+        for (std::size_t round = 1; round < n && !relax_all(false).empty(); ++round) {
+        }
+
+        std::vector<char> unbounded(n);
+        std::vector<uint32_t> stack = relax_all(true);
+        while (!stack.empty()) {
+            const uint32_t u = stack.back();
+            stack.pop_back();
+            if (unbounded[u]) {
+                continue;
+            }
+            unbounded[u] = true;
+            for (uint32_t e = graph.first_edge[u]; e < graph.first_edge[u + 1]; ++e) {
+                stack.push_back(graph.targets[e]);
+            }
+        }
+
+        Weight* dist = &dist_[row * n];
+        for (std::size_t v = 0; v < n; ++v) {
+            if (unbounded[v]) {
+                dist[v] = Traits::NegativeInfinity();
+            }
+            else if (reached[v] != std::numeric_limits<double>::infinity()) {
+                dist[v] = static_cast<Weight>(reached[v]);
+            }
+        }
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// The strongly connected components of a graph and its condensation DAG.
+// Components are numbered in topological order: every edge runs within a
+// component or from a component to a later one.
+struct Condensation {
+    // Component of every vertex.
+    std::vector<uint32_t> component;
+    // Vertices of component c, ascending, are
+    // vertices[first_vertex[c] .. first_vertex[c + 1]).
+    std::vector<uint32_t> first_vertex;
+    std::vector<uint32_t> vertices;
+
+    std::size_t size() const {
+        return first_vertex.empty() ? 0 : first_vertex.size() - 1;
+    }
+};
+
+// Tarjan's algorithm with an explicit stack, O(V + E). The out-edges of u
+// are targets[first_edge[u] .. first_edge[u + 1]).
+inline Condensation StrongComponents(std::span<const uint32_t> first_edge, std::span<const uint32_t> targets) {
+    const std::size_t n = first_edge.size() - 1;
+    constexpr uint32_t UNVISITED = static_cast<uint32_t>(-1);
+    std::vector<uint32_t> index(n, UNVISITED);
+    std::vector<uint32_t> low(n);
+    std::vector<char> on_stack(n);
+    std::vector<uint32_t> stack;
+    // Vertex and position in its edge list of every call still open.
+    std::vector<std::pair<uint32_t, uint32_t>> calls;
+    std::vector<uint32_t> finished(n);
+    uint32_t next_index = 0;
+    uint32_t found = 0;
+
+    for (uint32_t root = 0; root < n; ++root) {
+        if (index[root] != UNVISITED) {
+            continue;
+        }
+        calls.push_back({ root, first_edge[root] });
+        index[root] = low[root] = next_index++;
+        stack.push_back(root);
+        on_stack[root] = true;
+
+        while (!calls.empty()) {
+            auto& [u, edge] = calls.back();
+            if (edge < first_edge[u + 1]) {
+                const uint32_t v = targets[edge++];
+                if (index[v] == UNVISITED) {
+                    index[v] = low[v] = next_index++;
+                    stack.push_back(v);
+                    on_stack[v] = true;
+                    calls.push_back({ v, first_edge[v] });
+                }
+                else if (on_stack[v]) {
+                    low[u] = std::min(low[u], index[v]);
+                }
+                continue;
+            }
+
+            const uint32_t done = u;
+            calls.pop_back();
+            if (!calls.empty()) {
+                low[calls.back().first] = std::min(low[calls.back().first], low[done]);
+            }
+            if (low[done] == index[done]) {
+                // Tarjan finishes sinks first, so this is reverse topological
+                // order; it is flipped below.
+                uint32_t v;
+                do {
+                    v = stack.back();
+                    stack.pop_back();
+                    on_stack[v] = false;
+                    finished[v] = found;
+                } while (v != done);
+                ++found;
+            }
+        }
+    }
+
+    Condensation result;
+    result.component.resize(n);
+    result.first_vertex.assign(found + 1, 0);
+    for (std::size_t v = 0; v < n; ++v) {
+        result.component[v] = found - 1 - finished[v];
+        ++result.first_vertex[result.component[v] + 1];
+    }
+    for (std::size_t c = 0; c < found; ++c) {
+        result.first_vertex[c + 1] += result.first_vertex[c];
+    }
+    result.vertices.resize(n);
+    std::vector<uint32_t> fill(result.first_vertex.begin(), result.first_vertex.end() - 1);
+    for (uint32_t v = 0; v < n; ++v) {
+        result.vertices[fill[result.component[v]]++] = v;
+    }
+    return result;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed set of worker threads for fork-join loops. ParallelFor hands out
+// indices from a shared counter, the calling thread takes part in the work,
+// and the call returns only once every index is done, so each call acts as
+// a barrier. If func throws, the indices not yet handed out are skipped and
+// the first exception is rethrown from ParallelFor once all threads are done.
+class ThreadPool {
+public:
+    // threads counts the calling thread; 0 means one per hardware thread.
+    explicit ThreadPool(std::size_t threads) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (std::size_t t = 1; t < threads; ++t) {
+            workers_.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    std::size_t size() const {
+        return workers_.size() + 1;
+    }
+
+    template<typename Func>
+    void ParallelFor(std::size_t count, Func&& func) {
+        if (workers_.empty() || count <= 1) {
+            for (std::size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+            return;
+        }
+
+        using FuncType = std::remove_reference_t<Func>;
+        Job job{ [](void* f, std::size_t i) { (*static_cast<FuncType*>(f))(i); }, &func, count };
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            next_index_.store(0, std::memory_order_relaxed);
+            pending_workers_ = workers_.size();
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        RunJob(job);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_workers_ == 0; });
+        job_ = nullptr;
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+private:
+    struct Job {
+        void (*invoke)(void*, std::size_t);
+        void* func;
+        std::size_t count;
+    };
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Job* job_ = nullptr;
+    std::atomic<std::size_t> next_index_{ 0 };
+    std::size_t pending_workers_ = 0;
+    std::size_t generation_ = 0;
+    std::exception_ptr error_;
+    bool stop_ = false;
+
+    void RunJob(const Job& job) {
+        try {
+            for (std::size_t i; (i = next_index_.fetch_add(1, std::memory_order_relaxed)) < job.count;) {
+                job.invoke(job.func, i);
+            }
+        }
+        catch (...) {
+            next_index_.store(job.count, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+
+    void WorkerLoop() {
+        std::size_t seen_generation = 0;
+        for (;;) {
+            const Job* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+                if (stop_) {
+                    return;
+                }
+                seen_generation = generation_;
+                job = job_;
+            }
+
+            RunJob(*job);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_workers_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+};
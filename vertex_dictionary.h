@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Maps vertex names to dense ids in first-seen order. Names are copied once
+// (or, with InternView, referenced where they already live) into a monotonic
+// arena: no per-vertex heap allocation, and destroying the dictionary
+// releases them all at once. The hash map and the name table come from a
+// pool instead, since they regrow while interning and a monotonic arena
+// would keep every outgrown bucket array and vector buffer until the end.
+// Both sit behind a pointer, so the views handed out by Name() stay valid for
+// the lifetime of the dictionary (including across moves).
+class VertexDictionary {
+public:
+    using Id = uint32_t;
+    static constexpr Id NPOS = static_cast<Id>(-1);
+
+    VertexDictionary() = default;
+    VertexDictionary(const VertexDictionary&) = delete;
+    VertexDictionary& operator=(const VertexDictionary&) = delete;
+    VertexDictionary(VertexDictionary&&) = default;
+    VertexDictionary& operator=(VertexDictionary&&) = default;
+
+    Id Intern(std::string_view name) {
+        Storage& storage = GetStorage();
+        auto it = storage.ids.find(name);
+        if (it != storage.ids.end()) {
+            return it->second;
+        }
+
+        const Id id = static_cast<Id>(storage.names.size());
+        const std::string_view stored = Store(storage, name);
+        storage.names.push_back(stored);
+        storage.ids.emplace(stored, id);
+        return id;
+    }
+
+    // Like Intern, but stores the view itself instead of a copy. The caller
+    // guarantees the characters outlive the dictionary, typically by handing
+    // their owner to KeepAlive.
+    Id InternView(std::string_view name) {
+        Storage& storage = GetStorage();
+        auto [it, inserted] = storage.ids.emplace(name, static_cast<Id>(storage.names.size()));
+        if (inserted) {
+            storage.names.push_back(name);
+        }
+        return it->second;
+    }
+
+    void KeepAlive(std::shared_ptr<const void> owner) {
+        keep_alive_.push_back(std::move(owner));
+    }
+
+    Id Find(std::string_view name) const {
+        if (!storage_) {
+            return NPOS;
+        }
+        auto it = storage_->ids.find(name);
+        return it == storage_->ids.end() ? NPOS : it->second;
+    }
+
+    std::string_view Name(Id id) const {
+        return storage_->names[id];
+    }
+
+    std::size_t size() const {
+        return storage_ ? storage_->names.size() : 0;
+    }
+
+    void Reserve(std::size_t count) {
+        Storage& storage = GetStorage();
+        storage.ids.reserve(count);
+        storage.names.reserve(count);
+    }
+
+private:
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Storage {
+        // Declared first so the containers are gone before they are.
+        std::pmr::monotonic_buffer_resource arena{ BLOCK_SIZE };
+        std::pmr::unsynchronized_pool_resource pool;
+        std::pmr::unordered_map<std::string_view, Id> ids{ &pool };
+        std::pmr::vector<std::string_view> names{ &pool };
+    };
+
+    // Created on first insert, so empty and moved-from dictionaries hold no
+    // arena or pool.
+    std::unique_ptr<Storage> storage_;
+    std::vector<std::shared_ptr<const void>> keep_alive_;
+
+    Storage& GetStorage() {
+        if (!storage_) {
+            storage_ = std::make_unique<Storage>();
+        }
+        return *storage_;
+    }
+
+    static std::string_view Store(Storage& storage, std::string_view name) {
+        char* dst = static_cast<char*>(storage.arena.allocate(std::max<std::size_t>(name.size(), 1), 1));
+        std::memcpy(dst, name.data(), name.size());
+        return { dst, name.size() };
+    }
+};
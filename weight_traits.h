@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+// Per weight type: the value stored for unreachable pairs, the value marking
+// pairs whose distance is unbounded below (they reach through a negative
+// cycle), and an addition that never turns an unreachable operand, or an
+// overflow, into a finite distance.
+template<typename Weight>
+struct WeightTraits;
+
+template<>
+struct WeightTraits<double> {
+    static constexpr double Infinity() {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    static constexpr double NegativeInfinity() {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    static constexpr double Add(double lhs, double rhs) {
+        return lhs + rhs;
+    }
+};
+
+template<>
+struct WeightTraits<float> {
+    static constexpr float Infinity() {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    static constexpr float NegativeInfinity() {
+        return -std::numeric_limits<float>::infinity();
+    }
+
+    static constexpr float Add(float lhs, float rhs) {
+        return lhs + rhs;
+    }
+};
+
+// INT32_MAX and INT32_MIN double as the infinities; sums saturate at both ends,
+// and an unbounded operand keeps the sum unbounded, as -inf does in double.
+template<>
+struct WeightTraits<int32_t> {
+    static constexpr int32_t Infinity() {
+        return std::numeric_limits<int32_t>::max();
+    }
+
+    static constexpr int32_t NegativeInfinity() {
+        return std::numeric_limits<int32_t>::min();
+    }
+
+    static constexpr int32_t Add(int32_t lhs, int32_t rhs) {
+        if (lhs == Infinity() || rhs == Infinity()) {
+            return Infinity();
+        }
+        if (lhs == NegativeInfinity() || rhs == NegativeInfinity()) {
+            return NegativeInfinity();
+        }
+        const int64_t sum = static_cast<int64_t>(lhs) + rhs;
+        if (sum > Infinity()) {
+            return Infinity();
+        }
+        if (sum < NegativeInfinity()) {
+            return NegativeInfinity();
+        }
+        return static_cast<int32_t>(sum);
+    }
+};
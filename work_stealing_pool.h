@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Task pool for many independent jobs of uneven size, where ThreadPool's
+// fork-join loops do not fit. Submitted tasks are dealt round-robin onto
+// per-thread deques; a thread runs its own newest task first and, once its
+// deque is empty, steals the oldest task of another thread. Wait() puts the
+// calling thread to work as well and returns when every task has finished,
+// rethrowing the first exception a task let escape.
+class WorkStealingPool {
+public:
+    // threads counts the calling thread; 0 means one per hardware thread.
+    explicit WorkStealingPool(std::size_t threads) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (std::size_t t = 0; t < threads; ++t) {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+        for (std::size_t t = 1; t < threads; ++t) {
+            workers_.emplace_back([this, t] { WorkerLoop(t); });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    std::size_t size() const {
+        return queues_.size();
+    }
+
+    void Submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Queue& queue = *queues_[next_queue_++ % queues_.size()];
+            std::lock_guard<std::mutex> queue_lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+            ++queued_;
+            ++pending_;
+        }
+        wake_.notify_one();
+    }
+
+    void Wait() {
+        while (TryRunOne(0)) {
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return pending_ == 0; });
+        if (error_) {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // Slot 0 belongs to the thread that calls Wait().
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::size_t next_queue_ = 0;
+    // Tasks sitting in a deque, and tasks not finished yet.
+    std::size_t queued_ = 0;
+    std::size_t pending_ = 0;
+    std::exception_ptr error_;
+    bool stop_ = false;
+
+    bool TryRunOne(std::size_t self) {
+        std::function<void()> task;
+        for (std::size_t offset = 0; offset < queues_.size() && !task; ++offset) {
+            Queue& queue = *queues_[(self + offset) % queues_.size()];
+            std::lock_guard<std::mutex> queue_lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (offset == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        if (!task) {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --queued_;
+        }
+        std::exception_ptr error;
+        try {
+            task();
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !error_) {
+            error_ = error;
+        }
+        if (--pending_ == 0) {
+            idle_.notify_all();
+        }
+        return true;
+    }
+
+    void WorkerLoop(std::size_t self) {
+        for (;;) {
+            if (TryRunOne(self)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+            if (stop_ && queued_ == 0) {
+                return;
+            }
+        }
+    }
+};